@@ -4,44 +4,105 @@
 #include "vector.h"
 #include <string>
 #include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
 using namespace std;
 
 class Document;
 class Collection;
 
+//хэш ключа: строки побайтно, целые и указатели перемешиванием, остальное через std::hash
+template<typename K, typename Enable = void>
+struct KeyHash {
+    size_t operator()(const K& key) const;
+};
+
+template<typename K>
+struct KeyHash<K, typename enable_if<is_integral<K>::value || is_enum<K>::value || is_pointer<K>::value>::type> {
+    size_t operator()(const K& key) const;
+};
+
+template<>
+struct KeyHash<string> {
+    size_t operator()(const string& key) const;
+};
+
+//открытая адресация в стиле swiss table:
+//на каждую ячейку байт метаданных (пусто / удалено / 7 бит хэша),
+//поиск сравнивает сразу группу из 16 байт (SSE2, если есть) и только потом ключи
 template<typename K, typename V>
 class HashMap {
-private:
-    struct Node {
+public:
+    struct Entry {
         K key;
         V value;
-        Node* next;
-        Node(const K& k, const V& v);
+        template<typename KK, typename VV>
+        Entry(KK&& k, VV&& v) : key(std::forward<KK>(k)), value(std::forward<VV>(v)) {}
+    };
+
+    //обход без копирования: for (const auto& entry : map) entry.key, entry.value
+    class Iterator {
+    private:
+        const HashMap* map;
+        size_t index;
+        void skipFree();
+    public:
+        Iterator(const HashMap* owner, size_t start);
+        const Entry& operator*() const;
+        const Entry* operator->() const;
+        Iterator& operator++();
+        bool operator!=(const Iterator& other) const;
+        bool operator==(const Iterator& other) const;
     };
-    
-    Vector<Node*> buckets;//массив связныхсписков
-    size_t bucketCount;//размер таблицы
+
+private:
+    static const size_t GROUP_WIDTH = 16;
+    static const int8_t EMPTY = -128;
+    static const int8_t DELETED = -2;
+
+    int8_t* ctrl;//capacity байт метаданных
+    Entry* slots;//память без конструкторов, живые только ячейки с ctrl >= 0
+    size_t capacity;//0 или степень двойки, кратная GROUP_WIDTH
     size_t itemCount;//колво элементов
-    const double loadFactor = 0.75;//для ресайза
-    
-    size_t customHash(const string& str) const;//хэш функция для стр
-    size_t getBucketIndex(const K& key) const;//индекс связного списка
-    void resize();
+    size_t deletedCount;//ячейки DELETED, тоже удлиняют поиск
+    Allocator* allocator;//nullptr - куча
+
+    static size_t hashOf(const K& key);
+    size_t findIndex(const K& key, size_t hash) const;//capacity, если ключа нет
+    size_t findInsertIndex(size_t hash) const;
+    void allocate(size_t newCapacity);
+    void release();
+    void rehash(size_t newCapacity);
+    template<typename VV>
+    void insert(const K& key, VV&& value);
 
 public:
     HashMap();
+    explicit HashMap(Allocator* source);
     ~HashMap();
-    HashMap(const HashMap& other);
+    HashMap(const HashMap& other);//копия в куче, как у Vector
     HashMap& operator=(const HashMap& other);
     HashMap(HashMap&& other) noexcept;
     HashMap& operator=(HashMap&& other) noexcept;
     void put(const K& key, const V& value);
+    void put(const K& key, V&& value);//без копирования значения
     bool get(const K& key, V& value) const;
     bool remove(const K& key);
-    Vector<pair<K, V>> items() const;
+    Vector<pair<K, V>> items() const;//копия всех пар, для обхода есть forEach и begin/end
+    Iterator begin() const;
+    Iterator end() const;
+    //visit(const K&, const V&) или visit(const K&, V&) - ключ менять нельзя
+    template<typename F>
+    void forEach(F&& visit) const;
+    template<typename F>
+    void forEach(F&& visit);
     size_t size() const;
     void clear();
     bool contains(const K& key) const;
+    Allocator* getAllocator() const { return allocator; }
+    size_t memoryBytes() const { return capacity * (sizeof(Entry) + 1); }//ячейки и метаданные
 };
 
 #include "HashMapImpl.h"
@@ -2,199 +2,409 @@
 #define HASHMAPIMPL_H
 
 #include "HashMap.h"
+#include <cstring>
+#include <new>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//финальное перемешивание murmur3: каждый бит входа влияет на все биты выхода
+inline uint64_t mixHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+//по 8 байт за шаг вместо побайтного djb2
+inline uint64_t hashBytes(const char* data, size_t length) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = length * multiplier;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data + i, 8);
+        h = (h ^ mixHash(chunk)) * multiplier;
+    }
+    uint64_t tail = 0;
+    if (i < length) {
+        memcpy(&tail, data + i, length - i);
+        h = (h ^ mixHash(tail)) * multiplier;
+    }
+    return mixHash(h);
+}
+
+template<typename K, typename Enable>
+size_t KeyHash<K, Enable>::operator()(const K& key) const {
+    return (size_t)mixHash((uint64_t)std::hash<K>()(key));
+}
+
+template<typename K>
+size_t KeyHash<K, typename enable_if<is_integral<K>::value || is_enum<K>::value || is_pointer<K>::value>::type>::
+operator()(const K& key) const {
+    return (size_t)mixHash((uint64_t)(uintptr_t)key);
+}
+
+inline size_t KeyHash<string>::operator()(const string& key) const {
+    return (size_t)hashBytes(key.data(), key.size());
+}
+
+namespace hashmap_detail {
+
+//битовая маска совпадений в группе из 16 байт метаданных
+struct Group {
+#if defined(__SSE2__)
+    __m128i bytes;
+    explicit Group(const int8_t* p) : bytes(_mm_loadu_si128((const __m128i*)p)) {}
+    uint32_t match(int8_t h2) const {
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(h2)));
+    }
+    uint32_t matchEmpty() const {
+        return match(-128);
+    }
+    uint32_t matchFree() const {//пусто или удалено: у обоих старший бит, у занятых его нет
+        return (uint32_t)_mm_movemask_epi8(bytes);
+    }
+#else
+    const int8_t* p;
+    explicit Group(const int8_t* ptr) : p(ptr) {}
+    uint32_t match(int8_t h2) const {
+        uint32_t mask = 0;
+        for (int i = 0; i < 16; i++) {
+            if (p[i] == h2) mask |= 1u << i;
+        }
+        return mask;
+    }
+    uint32_t matchEmpty() const {
+        return match(-128);
+    }
+    uint32_t matchFree() const {
+        uint32_t mask = 0;
+        for (int i = 0; i < 16; i++) {
+            if (p[i] < 0) mask |= 1u << i;
+        }
+        return mask;
+    }
+#endif
+};
+
+inline int lowestBit(uint32_t mask) {
+    return __builtin_ctz(mask);
+}
+
+}
+
+template<typename K, typename V>
+size_t HashMap<K, V>::hashOf(const K& key) {
+    return KeyHash<K>()(key);
+}
 
 template<typename K, typename V>
-HashMap<K, V>::Node::Node(const K& k, const V& v) : key(k), value(v), next(nullptr) {}
+HashMap<K, V>::HashMap()
+    : ctrl(nullptr), slots(nullptr), capacity(0), itemCount(0), deletedCount(0), allocator(nullptr) {
+}
 
-//констр копирования
 template<typename K, typename V>
-HashMap<K, V>::HashMap(const HashMap& other) 
-    : bucketCount(other.bucketCount), itemCount(0) {
-    //инициализация связных списков
-    for (size_t i = 0; i < bucketCount; i++) {
-        buckets.push_back(nullptr);//пустые
-    }
-    //коопируем все элементы из other
-    auto otherItems = other.items();
-    for (size_t i = 0; i < otherItems.size(); i++) {
-        put(otherItems[i].first, otherItems[i].second);
+HashMap<K, V>::HashMap(Allocator* source)
+    : ctrl(nullptr), slots(nullptr), capacity(0), itemCount(0), deletedCount(0), allocator(source) {
+}
+
+template<typename K, typename V>
+HashMap<K, V>::~HashMap() {
+    release();
+}
+
+//копия раскладывается по тем же ячейкам, без пересчета хэшей
+template<typename K, typename V>
+HashMap<K, V>::HashMap(const HashMap& other)
+    : ctrl(nullptr), slots(nullptr), capacity(0), itemCount(0), deletedCount(0), allocator(nullptr) {
+    if (other.itemCount == 0) return;
+    allocate(other.capacity);
+    for (size_t i = 0; i < capacity; i++) {
+        if (other.ctrl[i] >= 0) {
+            new (&slots[i]) Entry(other.slots[i].key, other.slots[i].value);
+            ctrl[i] = other.ctrl[i];
+        } else if (other.ctrl[i] == DELETED) {
+            ctrl[i] = DELETED;
+        }
     }
+    itemCount = other.itemCount;
+    deletedCount = other.deletedCount;
 }
-//оператор присваивания
+
+//источник памяти остается свой
 template<typename K, typename V>
 HashMap<K, V>& HashMap<K, V>::operator=(const HashMap& other) {
     if (this != &other) {
-        clear();
-        bucketCount = other.bucketCount;//новый размер
-        itemCount = 0;
-        //и нициализация св списков
-        buckets.clear();
-        for (size_t i = 0; i < bucketCount; i++) {
-            buckets.push_back(nullptr);
-        }
-        //копируем
-        auto otherItems = other.items();
-        for (size_t i = 0; i < otherItems.size(); i++) {
-            put(otherItems[i].first, otherItems[i].second);
+        release();
+        for (size_t i = 0; i < other.capacity; i++) {
+            if (other.ctrl[i] >= 0) {
+                insert(other.slots[i].key, other.slots[i].value);
+            }
         }
     }
     return *this;
 }
 
-//конст перемещения
 template<typename K, typename V>
-HashMap<K, V>::HashMap(HashMap&& other) noexcept 
-    : buckets(std::move(other.buckets)), 
-      bucketCount(other.bucketCount), 
-      itemCount(other.itemCount) {
-    other.bucketCount = 0;
+HashMap<K, V>::HashMap(HashMap&& other) noexcept
+    : ctrl(other.ctrl), slots(other.slots), capacity(other.capacity),
+      itemCount(other.itemCount), deletedCount(other.deletedCount), allocator(other.allocator) {
+    other.ctrl = nullptr;
+    other.slots = nullptr;
+    other.capacity = 0;
     other.itemCount = 0;
+    other.deletedCount = 0;
 }
 
-//оператор перемещения
 template<typename K, typename V>
 HashMap<K, V>& HashMap<K, V>::operator=(HashMap&& other) noexcept {
     if (this != &other) {
-        clear();
-        //перемещаем из other
-        buckets = std::move(other.buckets);
-        bucketCount = other.bucketCount;
+        release();
+        ctrl = other.ctrl;
+        slots = other.slots;
+        capacity = other.capacity;
         itemCount = other.itemCount;
-        other.bucketCount = 0;
+        deletedCount = other.deletedCount;
+        allocator = other.allocator;
+        other.ctrl = nullptr;
+        other.slots = nullptr;
+        other.capacity = 0;
         other.itemCount = 0;
+        other.deletedCount = 0;
     }
     return *this;
 }
 
 template<typename K, typename V>
-size_t HashMap<K, V>::customHash(const string& str) const {
-    size_t hash = 5381;
-    const char* cStr = str.c_str();
-    for (size_t i = 0; i < str.length(); i++) {
-        hash = ((hash << 5) + hash) + cStr[i];
-    }
-    return hash;
+void HashMap<K, V>::allocate(size_t newCapacity) {
+    capacity = newCapacity;
+    ctrl = (int8_t*)allocateFrom(allocator, capacity, GROUP_WIDTH);
+    memset(ctrl, EMPTY, capacity);
+    slots = (Entry*)allocateFrom(allocator, capacity * sizeof(Entry), alignof(Entry));
+    itemCount = 0;
+    deletedCount = 0;
 }
 
 template<typename K, typename V>
-size_t HashMap<K, V>::getBucketIndex(const K& key) const {
-    if (bucketCount == 0) return 0;
-    return customHash(key) % bucketCount;
+void HashMap<K, V>::release() {
+    for (size_t i = 0; i < capacity; i++) {
+        if (ctrl[i] >= 0) {
+            slots[i].~Entry();
+        }
+    }
+    deallocateTo(allocator, ctrl, capacity);
+    deallocateTo(allocator, slots, capacity * sizeof(Entry));
+    ctrl = nullptr;
+    slots = nullptr;
+    capacity = 0;
+    itemCount = 0;
+    deletedCount = 0;
 }
 
+//группы обходятся треугольными шагами 1, 2, 3... - при степени двойки каждая ровно один раз
 template<typename K, typename V>
-void HashMap<K, V>::resize() {
-    size_t newBucketCount = bucketCount * 2;
-    if (newBucketCount == 0) newBucketCount = 8;//нач размер
-    Vector<Node*> newBuckets;
-    for (size_t i = 0; i < newBucketCount; i++) {
-        newBuckets.push_back(nullptr);//пустые списки
-    }
-    for (size_t i = 0; i < bucketCount; i++) {//хеш
-        Node* node = buckets[i];
-        while (node) {
-            Node* next = node->next;
-            size_t newIndex = customHash(node->key) % newBucketCount;
-            node->next = newBuckets[newIndex];//узел в начало цепочки нового списка
-            newBuckets[newIndex] = node;
-            node = next;
+size_t HashMap<K, V>::findIndex(const K& key, size_t hash) const {
+    if (capacity == 0) return capacity;
+    size_t groupMask = capacity / GROUP_WIDTH - 1;
+    size_t group = (hash >> 7) & groupMask;
+    int8_t h2 = (int8_t)(hash & 0x7F);
+    for (size_t step = 1; step <= groupMask + 1; step++) {
+        size_t base = group * GROUP_WIDTH;
+        hashmap_detail::Group g(ctrl + base);
+        for (uint32_t mask = g.match(h2); mask; mask &= mask - 1) {
+            size_t index = base + hashmap_detail::lowestBit(mask);
+            if (slots[index].key == key) {
+                return index;
+            }
         }
+        if (g.matchEmpty()) {
+            return capacity;//цепочка кончилась на пустой ячейке
+        }
+        group = (group + step) & groupMask;
     }
-    
-    buckets = newBuckets;
-    bucketCount = newBucketCount;
+    return capacity;
 }
 
 template<typename K, typename V>
-HashMap<K, V>::HashMap() : bucketCount(8), itemCount(0) {
-    for (size_t i = 0; i < bucketCount; i++) {
-        buckets.push_back(nullptr);
+size_t HashMap<K, V>::findInsertIndex(size_t hash) const {
+    size_t groupMask = capacity / GROUP_WIDTH - 1;
+    size_t group = (hash >> 7) & groupMask;
+    for (size_t step = 1;; step++) {
+        size_t base = group * GROUP_WIDTH;
+        uint32_t mask = hashmap_detail::Group(ctrl + base).matchFree();
+        if (mask) {
+            return base + hashmap_detail::lowestBit(mask);
+        }
+        group = (group + step) & groupMask;
     }
 }
 
 template<typename K, typename V>
-HashMap<K, V>::~HashMap() {
-    clear();
+void HashMap<K, V>::rehash(size_t newCapacity) {
+    int8_t* oldCtrl = ctrl;
+    Entry* oldSlots = slots;
+    size_t oldCapacity = capacity;
+    allocate(newCapacity);
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (oldCtrl[i] >= 0) {
+            size_t hash = hashOf(oldSlots[i].key);
+            size_t index = findInsertIndex(hash);
+            new (&slots[index]) Entry(std::move(oldSlots[i].key), std::move(oldSlots[i].value));
+            ctrl[index] = (int8_t)(hash & 0x7F);
+            itemCount++;
+            oldSlots[i].~Entry();
+        }
+    }
+    deallocateTo(allocator, oldCtrl, oldCapacity);
+    deallocateTo(allocator, oldSlots, oldCapacity * sizeof(Entry));
 }
 
 template<typename K, typename V>
-void HashMap<K, V>::put(const K& key, const V& value) {
-    if (bucketCount == 0 || (double)itemCount / bucketCount > loadFactor) {
-        resize();
-    }
-    
-    size_t index = getBucketIndex(key);
-    Node* node = buckets[index];
-    
-    while (node) {
-        if (node->key == key) {
-            node->value = value;
-            return;
-        }
-        node = node->next;
+template<typename VV>
+void HashMap<K, V>::insert(const K& key, VV&& value) {
+    size_t hash = hashOf(key);
+    size_t index = findIndex(key, hash);
+    if (index != capacity) {
+        slots[index].value = std::forward<VV>(value);
+        return;
     }
-    
-    Node* newNode = new Node(key, value);
-    newNode->next = buckets[index];
-    buckets[index] = newNode;
+
+    //заполненность не больше 7/8, иначе цепочки поиска резко растут
+    if (capacity == 0) {
+        allocate(GROUP_WIDTH);
+    } else if ((itemCount + deletedCount + 1) * 8 > capacity * 7) {
+        //много удаленных - чистим на месте, иначе вдвое больше
+        rehash(itemCount * 2 + 2 > capacity ? capacity * 2 : capacity);
+    }
+
+    index = findInsertIndex(hash);
+    if (ctrl[index] == DELETED) {
+        deletedCount--;
+    }
+    new (&slots[index]) Entry(key, std::forward<VV>(value));
+    ctrl[index] = (int8_t)(hash & 0x7F);
     itemCount++;
 }
 
+template<typename K, typename V>
+void HashMap<K, V>::put(const K& key, const V& value) {
+    insert(key, value);
+}
+
+template<typename K, typename V>
+void HashMap<K, V>::put(const K& key, V&& value) {
+    insert(key, std::move(value));
+}
+
 template<typename K, typename V>
 bool HashMap<K, V>::get(const K& key, V& value) const {
-    if (bucketCount == 0) return false;
-    
-    size_t index = getBucketIndex(key);
-    Node* node = buckets[index];
-    
-    while (node) {
-        if (node->key == key) {
-            value = node->value;
-            return true;
-        }
-        node = node->next;
-    }
-    return false;
+    size_t index = findIndex(key, hashOf(key));
+    if (index == capacity) return false;
+    value = slots[index].value;
+    return true;
 }
 
 template<typename K, typename V>
 bool HashMap<K, V>::remove(const K& key) {
-    if (bucketCount == 0) return false;
-    
-    size_t index = getBucketIndex(key);
-    Node* node = buckets[index];
-    Node* prev = nullptr;
-    
-    while (node) {
-        if (node->key == key) {
-            if (prev) {//середина или конец
-                prev->next = node->next;
-            } else {//начало
-                buckets[index] = node->next;
-            }
-            delete node;
-            itemCount--;
-            return true;
-        }
-        prev = node;
-        node = node->next;
+    size_t index = findIndex(key, hashOf(key));
+    if (index == capacity) return false;
+    slots[index].~Entry();
+    //если в группе есть пустая ячейка, поиск через эту группу не проходит - можно отметить пустой
+    size_t base = index - index % GROUP_WIDTH;
+    if (hashmap_detail::Group(ctrl + base).matchEmpty()) {
+        ctrl[index] = EMPTY;
+    } else {
+        ctrl[index] = DELETED;
+        deletedCount++;
     }
-    return false;
+    itemCount--;
+    return true;
 }
 
 template<typename K, typename V>
 Vector<pair<K, V>> HashMap<K, V>::items() const {
     Vector<pair<K, V>> result;
-    for (size_t i = 0; i < bucketCount; i++) {
-        Node* node = buckets[i];
-        while (node) {
-            result.push_back(make_pair(node->key, node->value));
-            node = node->next;
+    for (size_t i = 0; i < capacity; i++) {
+        if (ctrl[i] >= 0) {
+            result.push_back(make_pair(slots[i].key, slots[i].value));
         }
     }
     return result;
 }
 
+template<typename K, typename V>
+HashMap<K, V>::Iterator::Iterator(const HashMap* owner, size_t start) : map(owner), index(start) {
+    skipFree();
+}
+
+template<typename K, typename V>
+void HashMap<K, V>::Iterator::skipFree() {
+    while (index < map->capacity && map->ctrl[index] < 0) {
+        index++;
+    }
+}
+
+template<typename K, typename V>
+const typename HashMap<K, V>::Entry& HashMap<K, V>::Iterator::operator*() const {
+    return map->slots[index];
+}
+
+template<typename K, typename V>
+const typename HashMap<K, V>::Entry* HashMap<K, V>::Iterator::operator->() const {
+    return &map->slots[index];
+}
+
+template<typename K, typename V>
+typename HashMap<K, V>::Iterator& HashMap<K, V>::Iterator::operator++() {
+    index++;
+    skipFree();
+    return *this;
+}
+
+template<typename K, typename V>
+bool HashMap<K, V>::Iterator::operator!=(const Iterator& other) const {
+    return index != other.index;
+}
+
+template<typename K, typename V>
+bool HashMap<K, V>::Iterator::operator==(const Iterator& other) const {
+    return index == other.index;
+}
+
+template<typename K, typename V>
+typename HashMap<K, V>::Iterator HashMap<K, V>::begin() const {
+    return Iterator(this, 0);
+}
+
+template<typename K, typename V>
+typename HashMap<K, V>::Iterator HashMap<K, V>::end() const {
+    return Iterator(this, capacity);
+}
+
+template<typename K, typename V>
+template<typename F>
+void HashMap<K, V>::forEach(F&& visit) const {
+    for (size_t i = 0; i < capacity; i++) {
+        if (ctrl[i] >= 0) {
+            visit(static_cast<const K&>(slots[i].key), static_cast<const V&>(slots[i].value));
+        }
+    }
+}
+
+//значения можно менять на месте, но не удалять и не вставлять во время обхода
+template<typename K, typename V>
+template<typename F>
+void HashMap<K, V>::forEach(F&& visit) {
+    for (size_t i = 0; i < capacity; i++) {
+        if (ctrl[i] >= 0) {
+            visit(static_cast<const K&>(slots[i].key), slots[i].value);
+        }
+    }
+}
+
 template<typename K, typename V>
 size_t HashMap<K, V>::size() const {
     return itemCount;
@@ -202,22 +412,12 @@ size_t HashMap<K, V>::size() const {
 
 template<typename K, typename V>
 void HashMap<K, V>::clear() {
-    for (size_t i = 0; i < bucketCount; i++) {
-        Node* node = buckets[i];
-        while (node) {
-            Node* next = node->next;
-            delete node;
-            node = next;
-        }
-        buckets[i] = nullptr;
-    }
-    itemCount = 0;
+    release();
 }
 
 template<typename K, typename V>
 bool HashMap<K, V>::contains(const K& key) const {
-    V value;
-    return get(key, value);
+    return findIndex(key, hashOf(key)) != capacity;
 }
 
 #endif
@@ -329,7 +329,7 @@ Vector<string> parsestringArray(const string& jsonString) {
 }
 
 HashMap<string, string> JsonParser::parseSingleObject() {
-    HashMap<string, string> result;
+    HashMap<string, string> result(allocator);
 
     if (jsonStr[pos] != '{') return result;
     pos++;
@@ -697,7 +697,7 @@ void JsonParser::parseNull() {
 }
 
 Vector<string> JsonParser::parsestringArray() {
-    Vector<string> result;
+    Vector<string> result(allocator);
 
     if (jsonStr[pos] != '[') return result;
     pos++;
@@ -792,7 +792,7 @@ Vector<HashMap<string, string>> JsonParser::parseArray(const string& json) {
     pos = 0;
     skipWhitespace();
 
-    Vector<HashMap<string, string>> result;
+    Vector<HashMap<string, string>> result(allocator);
 
     if (jsonStr[pos] != '[') return result;
     pos++;
@@ -805,8 +805,7 @@ Vector<HashMap<string, string>> JsonParser::parseArray(const string& json) {
         }
 
         if (jsonStr[pos] == '{') {
-            HashMap<string, string> obj = parseSingleObject();
-            result.push_back(obj);
+            result.push_back(parseSingleObject());
         } else if (jsonStr[pos] == 'n') {
             parseNull();
         } else {
@@ -10,6 +10,7 @@ class JsonParser {
 private:
     string jsonStr;
     size_t pos;
+    Allocator* allocator;//память для результатов, nullptr - куча
     
     void skipWhitespace();
     string parsestring();
@@ -22,7 +23,7 @@ private:
     string getCurrentNumberString();
     
 public:
-    JsonParser() : pos(0) {}
+    explicit JsonParser(Allocator* source = nullptr) : pos(0), allocator(source) {}
     
     HashMap<string, string> parseObject();
     Vector<HashMap<string, string>> parseArray(const string& json);
@@ -2,25 +2,17 @@
 #include <cctype>
 
 QueryCondition::QueryCondition()
-    : type(ConditionType::EQUAL), field(""), value("") {
+    : type(ConditionType::EQUAL), field(""), value(""), fieldId(UNBOUND), valueCode(UNBOUND) {
 }
 
 QueryCondition::QueryCondition(ConditionType t, const string& f, const string& v) 
-    : type(t), field(f), value(v) {}
+    : type(t), field(f), value(v), fieldId(UNBOUND), valueCode(UNBOUND) {}
 
 
 QueryCondition::QueryCondition(const QueryCondition& other)
-    : type(other.type), field(other.field), value(other.value) {
-   
-
-    for (size_t i = 0; i < other.inValues.size(); i++) {
-        inValues.push_back(other.inValues[i]);
-    }
-    
-
-    for (size_t i = 0; i < other.subConditions.size(); i++) {
-        subConditions.push_back(other.subConditions[i]);
-    }
+    : type(other.type), field(other.field), value(other.value),
+      inValues(other.inValues), subConditions(other.subConditions),
+      fieldId(other.fieldId), valueCode(other.valueCode), inCodes(other.inCodes) {
 }
 
 
@@ -29,17 +21,11 @@ QueryCondition& QueryCondition::operator=(const QueryCondition& other) {
         type = other.type;
         field = other.field;
         value = other.value;
-        
-
-        inValues.clear();
-        for (size_t i = 0; i < other.inValues.size(); i++) {
-            inValues.push_back(other.inValues[i]);
-        }
-        
-        subConditions.clear();
-        for (size_t i = 0; i < other.subConditions.size(); i++) {
-            subConditions.push_back(other.subConditions[i]);
-        }
+        fieldId = other.fieldId;
+        valueCode = other.valueCode;
+        inCodes = other.inCodes;
+        inValues = other.inValues;
+        subConditions = other.subConditions;
     }
     return *this;
 }
@@ -49,7 +35,10 @@ QueryCondition::QueryCondition(QueryCondition&& other) noexcept
       field(std::move(other.field)), 
       value(std::move(other.value)),
       inValues(std::move(other.inValues)),
-      subConditions(std::move(other.subConditions)) {
+      subConditions(std::move(other.subConditions)),
+      fieldId(other.fieldId),
+      valueCode(other.valueCode),
+      inCodes(std::move(other.inCodes)) {
 }
 
 QueryCondition& QueryCondition::operator=(QueryCondition&& other) noexcept {
@@ -59,6 +48,9 @@ QueryCondition& QueryCondition::operator=(QueryCondition&& other) noexcept {
         value = std::move(other.value);
         inValues = std::move(other.inValues);
         subConditions = std::move(other.subConditions);
+        fieldId = other.fieldId;
+        valueCode = other.valueCode;
+        inCodes = std::move(other.inCodes);
     }
     return *this;
 }
@@ -107,8 +99,8 @@ bool ConditionParser::parseBoolean() {
     return false;
 }
 
-Vector<string> ConditionParser::parseArray() {
-    Vector<string> result;
+Vector<string, 4> ConditionParser::parseArray() {
+    Vector<string, 4> result;
     
     if (jsonStr[pos] != '[') return result;
     pos++;
@@ -215,54 +207,64 @@ QueryCondition ConditionParser::parseConditionObject() {
         else {
             if (jsonStr[pos] == '{') {
                 pos++;
-                skipWhitespace();
-                
-                string operatorKey = parsestring();
-                skipWhitespace();
-                
-                if (jsonStr[pos] != ':') break;
-                pos++;
-                skipWhitespace();
-                
-                QueryCondition subCondition(ConditionType::EQUAL, key, "");
-                
-                if (operatorKey == "$eq") {
-                    subCondition.type = ConditionType::EQUAL;
-                    if (jsonStr[pos] == '"') {
-                        subCondition.value = parsestring();
-                    } else {
-                        double num = parseNumber();
-                        subCondition.value = to_string(num);
+                //несколько операторов для одного поля: {"$gt": a, "$lt": b}
+                while (pos < jsonStr.length()) {
+                    skipWhitespace();
+                    if (jsonStr[pos] == '}') break;
+                    
+                    string operatorKey = parsestring();
+                    skipWhitespace();
+                    
+                    if (jsonStr[pos] != ':') break;
+                    pos++;
+                    skipWhitespace();
+                    
+                    QueryCondition subCondition(ConditionType::EQUAL, key, "");
+                    
+                    if (operatorKey == "$eq") {
+                        subCondition.type = ConditionType::EQUAL;
+                        if (jsonStr[pos] == '"') {
+                            subCondition.value = parsestring();
+                        } else {
+                            double num = parseNumber();
+                            subCondition.value = to_string(num);
+                        }
                     }
-                }
-                else if (operatorKey == "$gt") {
-                    subCondition.type = ConditionType::GREATER_THAN;
-                    if (jsonStr[pos] == '"') {
-                        subCondition.value = parsestring();
-                    } else {
-                        double num = parseNumber();
-                        subCondition.value = to_string(num);
+                    else if (operatorKey == "$gt") {
+                        subCondition.type = ConditionType::GREATER_THAN;
+                        if (jsonStr[pos] == '"') {
+                            subCondition.value = parsestring();
+                        } else {
+                            double num = parseNumber();
+                            subCondition.value = to_string(num);
+                        }
                     }
-                }
-                else if (operatorKey == "$lt") {
-                    subCondition.type = ConditionType::LESS_THAN;
-                    if (jsonStr[pos] == '"') {
+                    else if (operatorKey == "$lt") {
+                        subCondition.type = ConditionType::LESS_THAN;
+                        if (jsonStr[pos] == '"') {
+                            subCondition.value = parsestring();
+                        } else {
+                            double num = parseNumber();
+                            subCondition.value = to_string(num);
+                        }
+                    }
+                    else if (operatorKey == "$like") {
+                        subCondition.type = ConditionType::LIKE;
                         subCondition.value = parsestring();
+                    }
+                    else if (operatorKey == "$in") {
+                        subCondition.type = ConditionType::IN;
+                        subCondition.inValues = parseArray();
+                    }
+                    
+                    condition.subConditions.push_back(subCondition);
+                    skipWhitespace();
+                    if (jsonStr[pos] == ',') {
+                        pos++;
                     } else {
-                        double num = parseNumber();
-                        subCondition.value = to_string(num);
+                        break;
                     }
                 }
-                else if (operatorKey == "$like") {
-                    subCondition.type = ConditionType::LIKE;
-                    subCondition.value = parsestring();
-                }
-                else if (operatorKey == "$in") {
-                    subCondition.type = ConditionType::IN;
-                    subCondition.inValues = parseArray();
-                }
-                
-                condition.subConditions.push_back(subCondition);
                 skipWhitespace();
                 if (jsonStr[pos] == '}') pos++;
             } else {
@@ -3,6 +3,7 @@
 
 #include "vector.h"
 #include "HashMap.h"
+#include <cstdint>
 using namespace std;
 
 enum class ConditionType {
@@ -19,8 +20,13 @@ struct QueryCondition {
     ConditionType type;
     string field;
     string value;
-    Vector<string> inValues;
+    Vector<string, 4> inValues;//обычно пара значений - без выделения памяти
     Vector<QueryCondition> subConditions;
+    //номер field в словаре коллекции и коды value/inValues, проставляются один раз на запрос
+    uint32_t fieldId;
+    uint32_t valueCode;
+    Vector<uint32_t, 4> inCodes;
+    static const uint32_t UNBOUND = 0xFFFFFFFEu;
     QueryCondition();
     
     QueryCondition(ConditionType t, const string& f = "", const string& v = "");
@@ -41,7 +47,7 @@ private:
     string parsestring();
     double parseNumber();
     bool parseBoolean();
-    Vector<string> parseArray();
+    Vector<string, 4> parseArray();
     QueryCondition parseConditionObject();
     
 public:
@@ -2,166 +2,311 @@
 #define VECTORIMPL_H
 
 #include "vector.h"
+#include <utility>
+
+template<typename T, size_t N>
+Vector<T, N>::Vector() : data(this->inlineData()), capacity(N), sizeVal(0), allocator(nullptr) {}
+
+template<typename T, size_t N>
+Vector<T, N>::Vector(Allocator* source) : data(this->inlineData()), capacity(N), sizeVal(0), allocator(source) {}
+
+template<typename T, size_t N>
+Vector<T, N>::~Vector() {
+    clear();
+}
 
 //конст копирования
-template<typename T>
-Vector<T>::Vector(const Vector& other) 
-    : capacity(other.capacity), sizeVal(other.sizeVal) {
-    data = new T[capacity];
-    for (size_t i = 0; i < sizeVal; i++) {
-        data[i] = other.data[i];
+template<typename T, size_t N>
+Vector<T, N>::Vector(const Vector& other)
+    : data(this->inlineData()), capacity(N), sizeVal(0), allocator(nullptr) {
+    reserve(other.sizeVal);
+    for (size_t i = 0; i < other.sizeVal; i++) {
+        new (&data[i]) T(other.data[i]);
     }
+    sizeVal = other.sizeVal;
 }
 
 //опер присваивания
-template<typename T>
-Vector<T>& Vector<T>::operator=(const Vector& other) {
+template<typename T, size_t N>
+Vector<T, N>& Vector<T, N>::operator=(const Vector& other) {
     if (this != &other) {
-        delete[] data;
-        capacity = other.capacity;
-        sizeVal = other.sizeVal;
-        data = new T[capacity];
-        for (size_t i = 0; i < sizeVal; i++) {
-            data[i] = other.data[i];
+        destroyAll();
+        reserve(other.sizeVal);
+        for (size_t i = 0; i < other.sizeVal; i++) {
+            new (&data[i]) T(other.data[i]);
         }
+        sizeVal = other.sizeVal;
     }
     return *this;
 }
 
 //конст перемещения
-template<typename T>
-Vector<T>::Vector(Vector&& other) noexcept 
-    : data(other.data), capacity(other.capacity), sizeVal(other.sizeVal) {
-    other.data = nullptr;
-    other.capacity = 0;
-    other.sizeVal = 0;
+template<typename T, size_t N>
+Vector<T, N>::Vector(Vector&& other) noexcept
+    : data(this->inlineData()), capacity(N), sizeVal(0), allocator(nullptr) {
+    takeFrom(std::move(other));
 }
 
 //оператор перемещения
-template<typename T>
-Vector<T>& Vector<T>::operator=(Vector&& other) noexcept {
+template<typename T, size_t N>
+Vector<T, N>& Vector<T, N>::operator=(Vector&& other) noexcept {
     if (this != &other) {
-        delete[] data;
-        data = other.data;
-        capacity = other.capacity;
-        sizeVal = other.sizeVal;
-        other.data = nullptr;
-        other.capacity = 0;
-        other.sizeVal = 0;
+        clear();
+        takeFrom(std::move(other));
     }
     return *this;
 }
 
-template<typename T>
-Vector<T>::Vector() : data(nullptr), capacity(0), sizeVal(0) {}
+template<typename T, size_t N>
+template<size_t M>
+Vector<T, N>::Vector(Vector<T, M>&& other) noexcept
+    : data(this->inlineData()), capacity(N), sizeVal(0), allocator(nullptr) {
+    takeFrom(std::move(other));
+}
 
-template<typename T>
-Vector<T>::~Vector() {
-    delete[] data;
+template<typename T, size_t N>
+template<size_t M>
+Vector<T, N>& Vector<T, N>::operator=(Vector<T, M>&& other) noexcept {
+    clear();
+    takeFrom(std::move(other));
+    return *this;
 }
 
-template<typename T>
-void Vector<T>::push_back(const T& value) {
-    if (sizeVal >= capacity) {
-        size_t newCapacity = capacity == 0 ? 1 : capacity * 2;
-        T* newData = new T[newCapacity];
-        for (size_t i = 0; i < sizeVal; i++) {
-            newData[i] = std::move(data[i]);  
+//буфер в куче или арене забирается целиком, встроенные элементы переносятся по одному
+template<typename T, size_t N>
+template<size_t M>
+void Vector<T, N>::takeFrom(Vector<T, M>&& other) {
+    allocator = other.allocator;
+    if (!other.isInline()) {
+        if (other.data) {
+            data = other.data;
+            capacity = other.capacity;
+            sizeVal = other.sizeVal;
         }
-        delete[] data;
-        data = newData;
-        capacity = newCapacity;
+        other.data = other.inlineData();
+        other.capacity = M;
+        other.sizeVal = 0;
+        return;
+    }
+    reserve(other.sizeVal);
+    for (size_t i = 0; i < other.sizeVal; i++) {
+        new (&data[i]) T(std::move(other.data[i]));
+    }
+    sizeVal = other.sizeVal;
+    other.destroyAll();
+}
+
+template<typename T, size_t N>
+void Vector<T, N>::destroyAll() {
+    for (size_t i = 0; i < sizeVal; i++) {
+        data[i].~T();
+    }
+    sizeVal = 0;
+}
+
+template<typename T, size_t N>
+void Vector<T, N>::freeStorage() {
+    if (!isInline()) {
+        deallocateTo(allocator, data, capacity * sizeof(T));
+    }
+    data = this->inlineData();
+    capacity = N;
+}
+
+//перенос в новый буфер перемещением, без копий элементов
+template<typename T, size_t N>
+void Vector<T, N>::grow(size_t newCapacity) {
+    T* newData = (T*)allocateFrom(allocator, newCapacity * sizeof(T), alignof(T));
+    for (size_t i = 0; i < sizeVal; i++) {
+        new (&newData[i]) T(std::move(data[i]));
+        data[i].~T();
+    }
+    size_t count = sizeVal;
+    freeStorage();
+    data = newData;
+    capacity = newCapacity;
+    sizeVal = count;
+}
+
+template<typename T, size_t N>
+void Vector<T, N>::growFor(size_t extra) {
+    size_t needed = sizeVal + extra;
+    if (needed <= capacity) return;
+    size_t newCapacity = capacity == 0 ? 1 : capacity * 2;
+    if (newCapacity < needed) newCapacity = needed;
+    grow(newCapacity);
+}
+
+template<typename T, size_t N>
+void Vector<T, N>::reserve(size_t count) {
+    if (count > capacity) {
+        grow(count);
+    }
+}
+
+template<typename T, size_t N>
+template<typename... Args>
+T& Vector<T, N>::emplace_back(Args&&... args) {
+    if (sizeVal < capacity) {
+        new (&data[sizeVal]) T(std::forward<Args>(args)...);
+        return data[sizeVal++];
     }
-    data[sizeVal++] = value;
+    //новый элемент строится до переноса старых: args могут ссылаться на них
+    size_t newCapacity = capacity == 0 ? 1 : capacity * 2;
+    T* newData = (T*)allocateFrom(allocator, newCapacity * sizeof(T), alignof(T));
+    new (&newData[sizeVal]) T(std::forward<Args>(args)...);
+    for (size_t i = 0; i < sizeVal; i++) {
+        new (&newData[i]) T(std::move(data[i]));
+        data[i].~T();
+    }
+    size_t count = sizeVal;
+    freeStorage();
+    data = newData;
+    capacity = newCapacity;
+    sizeVal = count + 1;
+    return data[count];
+}
+
+template<typename T, size_t N>
+void Vector<T, N>::push_back(const T& value) {
+    emplace_back(value);
+}
+
+template<typename T, size_t N>
+void Vector<T, N>::push_back(T&& value) {
+    emplace_back(std::move(value));
 }
 
-template<typename T>
-void Vector<T>::push_back(T&& value) {
-    if (sizeVal >= capacity) {
-        size_t newCapacity = capacity == 0 ? 1 : capacity * 2;
-        T* newData = new T[newCapacity];
-        for (size_t i = 0; i < sizeVal; i++) {
-            newData[i] = std::move(data[i]);  
+template<typename T, size_t N>
+void Vector<T, N>::insert(size_t position, const T* first, const T* last) {
+    size_t count = last - first;
+    if (count == 0) return;
+    if (first >= data && first < data + sizeVal) {//вставка куска самого себя
+        Vector<T> copy;
+        copy.insert(0, first, last);
+        insert(position, &copy[0], &copy[0] + count);
+        return;
+    }
+    growFor(count);
+    //хвост сдвигается с конца: за старый конец конструируем, внутри присваиваем
+    for (size_t i = sizeVal; i > position; i--) {
+        size_t to = i - 1 + count;
+        if (to >= sizeVal) {
+            new (&data[to]) T(std::move(data[i - 1]));
+        } else {
+            data[to] = std::move(data[i - 1]);
+        }
+    }
+    for (size_t k = 0; k < count; k++) {
+        if (position + k < sizeVal) {
+            data[position + k] = first[k];
+        } else {
+            new (&data[position + k]) T(first[k]);
         }
-        delete[] data;
-        data = newData;
-        capacity = newCapacity;
     }
-    data[sizeVal++] = std::move(value); 
+    sizeVal += count;
+}
+
+template<typename T, size_t N>
+template<size_t M>
+void Vector<T, N>::append(Vector<T, M>&& other) {
+    if (sizeVal == 0 && allocator == other.allocator && !other.isInline()) {
+        clear();
+        takeFrom(std::move(other));//пустой вектор просто забирает буфер
+        return;
+    }
+    growFor(other.sizeVal);
+    for (size_t i = 0; i < other.sizeVal; i++) {
+        new (&data[sizeVal + i]) T(std::move(other.data[i]));
+    }
+    sizeVal += other.sizeVal;
+    other.clear();
 }
 
-template<typename T>
-void Vector<T>::pop_back() {
+template<typename T, size_t N>
+void Vector<T, N>::erase(size_t first, size_t last) {
+    if (last > sizeVal) last = sizeVal;
+    if (first >= last) return;
+    size_t count = last - first;
+    for (size_t i = last; i < sizeVal; i++) {
+        data[i - count] = std::move(data[i]);
+    }
+    for (size_t i = sizeVal - count; i < sizeVal; i++) {
+        data[i].~T();
+    }
+    sizeVal -= count;
+}
+
+template<typename T, size_t N>
+void Vector<T, N>::pop_back() {
     if (sizeVal > 0) {
-        sizeVal--;
+        data[--sizeVal].~T();
     }
 }
 
-template<typename T>
-T& Vector<T>::back() {
+template<typename T, size_t N>
+T& Vector<T, N>::back() {
     return data[sizeVal - 1];
 }
 
-template<typename T>
-const T& Vector<T>::back() const {
+template<typename T, size_t N>
+const T& Vector<T, N>::back() const {
     return data[sizeVal - 1];
 }
 
-template<typename T>
-T& Vector<T>::operator[](size_t index) {
+template<typename T, size_t N>
+T& Vector<T, N>::operator[](size_t index) {
     return data[index];
 }
 
-template<typename T>
-const T& Vector<T>::operator[](size_t index) const {
+template<typename T, size_t N>
+const T& Vector<T, N>::operator[](size_t index) const {
     return data[index];
 }
 
-template<typename T>
-size_t Vector<T>::size() const {
+template<typename T, size_t N>
+size_t Vector<T, N>::size() const {
     return sizeVal;
 }
 
-template<typename T>
-bool Vector<T>::empty() const {
+template<typename T, size_t N>
+bool Vector<T, N>::empty() const {
     return sizeVal == 0;
 }
 
-template<typename T>
-void Vector<T>::clear() {
-    delete[] data;
-    data = nullptr;
-    capacity = 0;
-    sizeVal = 0;
+template<typename T, size_t N>
+void Vector<T, N>::clear() {
+    destroyAll();
+    freeStorage();
 }
 
-template<typename T>
-Vector<T>::Iterator::Iterator(T* p) : ptr(p) {}
+template<typename T, size_t N>
+Vector<T, N>::Iterator::Iterator(T* p) : ptr(p) {}
 
-template<typename T>
-T& Vector<T>::Iterator::operator*() { 
-    return *ptr; 
+template<typename T, size_t N>
+T& Vector<T, N>::Iterator::operator*() {
+    return *ptr;
 }
 
-template<typename T>
-typename Vector<T>::Iterator& Vector<T>::Iterator::operator++() { 
-    ptr++; 
-    return *this; 
+template<typename T, size_t N>
+typename Vector<T, N>::Iterator& Vector<T, N>::Iterator::operator++() {
+    ptr++;
+    return *this;
 }
 
-template<typename T>
-bool Vector<T>::Iterator::operator!=(const Iterator& other) { 
-    return ptr != other.ptr; 
+template<typename T, size_t N>
+bool Vector<T, N>::Iterator::operator!=(const Iterator& other) {
+    return ptr != other.ptr;
 }
 
-template<typename T>
-typename Vector<T>::Iterator Vector<T>::begin() { 
-    return Iterator(data); 
+template<typename T, size_t N>
+typename Vector<T, N>::Iterator Vector<T, N>::begin() {
+    return Iterator(data);
 }
 
-template<typename T>
-typename Vector<T>::Iterator Vector<T>::end() { 
-    return Iterator(data + sizeVal); 
+template<typename T, size_t N>
+typename Vector<T, N>::Iterator Vector<T, N>::end() {
+    return Iterator(data + sizeVal);
 }
 
-#endif
\ No newline at end of file
+#endif
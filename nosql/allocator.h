@@ -0,0 +1,34 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+using namespace std;
+
+//источник памяти для Vector и HashMap, nullptr - обычная куча
+//контейнер помнит свой источник: при перемещении он уходит вместе с буфером,
+//копия всегда берет память из кучи, чтобы не пережить чужую арену
+class Allocator {
+public:
+    virtual ~Allocator() {}
+    virtual void* allocate(size_t size, size_t align = 8) = 0;
+    virtual void deallocate(void* ptr, size_t size) = 0;
+};
+
+inline void* allocateFrom(Allocator* allocator, size_t size, size_t align) {
+    if (allocator) {
+        return allocator->allocate(size, align);
+    }
+    return ::operator new(size);
+}
+
+inline void deallocateTo(Allocator* allocator, void* ptr, size_t size) {
+    if (!ptr) return;
+    if (allocator) {
+        allocator->deallocate(ptr, size);
+    } else {
+        ::operator delete(ptr);
+    }
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include "arena.h"
+#include <cstdint>
+#include <new>
+#include <utility>
+
+Arena::Arena(size_t chunkBytes)
+    : chunkSize(chunkBytes), current(nullptr), remaining(0), reserved(0), used(0), wasted(0) {
+}
+
+Arena::~Arena() {
+    reset();
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    size_t padding = (align - ((uintptr_t)current & (align - 1))) & (align - 1);
+    if (!current || padding + size > remaining) {
+        //большой объект получает свой блок, остаток текущего не теряется
+        size_t bytes = size + align > chunkSize ? size + align : chunkSize;
+        char* chunk = new char[bytes];
+        chunks.push_back(chunk);
+        reserved += bytes;
+        if (bytes > chunkSize && current) {
+            used += size;
+            uintptr_t aligned = ((uintptr_t)chunk + align - 1) & ~(uintptr_t)(align - 1);
+            return (void*)aligned;
+        }
+        current = chunk;
+        remaining = bytes;
+        padding = (align - ((uintptr_t)current & (align - 1))) & (align - 1);
+    }
+    char* result = current + padding;
+    current += padding + size;
+    remaining -= padding + size;
+    used += size;
+    return result;
+}
+
+void Arena::reset() {
+    for (size_t i = 0; i < chunks.size(); i++) {
+        delete[] chunks[i];
+    }
+    chunks.clear();
+    current = nullptr;
+    remaining = 0;
+    reserved = 0;
+    used = 0;
+    wasted = 0;
+}
+
+void Arena::swap(Arena& other) {
+    std::swap(chunks, other.chunks);
+    std::swap(chunkSize, other.chunkSize);
+    std::swap(current, other.current);
+    std::swap(remaining, other.remaining);
+    std::swap(reserved, other.reserved);
+    std::swap(used, other.used);
+    std::swap(wasted, other.wasted);
+}
@@ -0,0 +1,39 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "vector.h"
+#include "allocator.h"
+#include <cstddef>
+using namespace std;
+
+//блоки по chunkSize, выделение сдвигом указателя, по одному освобождения нет
+//уже выданная память не перемещается, пока не вызван reset
+//как Allocator годится для временных контейнеров: освобождение только учитывается
+class Arena : public Allocator {
+private:
+    Vector<char*> chunks;
+    size_t chunkSize;
+    char* current;
+    size_t remaining;
+    size_t reserved;//взято у системы
+    size_t used;//выдано
+    size_t wasted;//выдано, но больше не нужно (удаленные и замененные)
+
+public:
+    explicit Arena(size_t chunkBytes = 1 << 20);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = 8) override;
+    void deallocate(void*, size_t size) override { release(size); }
+    void release(size_t size) { wasted += size; }//только учет, память вернется при reset
+    void reset();
+    void swap(Arena& other);
+
+    size_t bytesReserved() const { return reserved; }
+    size_t bytesUsed() const { return used; }
+    size_t bytesWasted() const { return wasted; }
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+using namespace std;
+
+//little-endian запись/чтение чисел для бинарных форматов на диске
+inline void appendUint32(string& out, uint32_t value) {
+    char buf[4];
+    buf[0] = (char)(value & 0xFF);
+    buf[1] = (char)((value >> 8) & 0xFF);
+    buf[2] = (char)((value >> 16) & 0xFF);
+    buf[3] = (char)((value >> 24) & 0xFF);
+    out.append(buf, 4);
+}
+
+inline uint32_t readUint32(const char* p) {
+    const unsigned char* u = (const unsigned char*)p;
+    return (uint32_t)u[0] | ((uint32_t)u[1] << 8) |
+           ((uint32_t)u[2] << 16) | ((uint32_t)u[3] << 24);
+}
+
+inline void appendUint64(string& out, uint64_t value) {
+    appendUint32(out, (uint32_t)(value & 0xFFFFFFFFu));
+    appendUint32(out, (uint32_t)(value >> 32));
+}
+
+inline uint64_t readUint64(const char* p) {
+    return (uint64_t)readUint32(p) | ((uint64_t)readUint32(p + 4) << 32);
+}
+
+inline void appendString(string& out, const string& value) {
+    appendUint32(out, (uint32_t)value.size());
+    out.append(value);
+}
+
+//читает строку с префиксом длины, false если данные кончились
+inline bool readString(const char* data, size_t len, size_t& pos, string& value) {
+    if (pos + 4 > len) return false;
+    uint32_t strLen = readUint32(data + pos);
+    pos += 4;
+    if (pos + strLen > len) return false;
+    value.assign(data + pos, strLen);
+    pos += strLen;
+    return true;
+}
+
+//write до конца, с повтором после частичной записи и EINTR
+inline bool writeFully(int fd, const string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+//CRC-32C (Castagnoli), таблица строится один раз
+inline uint32_t crc32c(const char* data, size_t len, uint32_t crc = 0) {
+    struct Table {
+        uint32_t values[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+                }
+                values[i] = c;
+            }
+        }
+    };
+    static const Table table;
+    crc = ~crc;
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        crc = table.values[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+//fsync каталога, чтобы rename/создание/удаление файла пережили падение
+inline bool fsyncDirectoryOf(const string& path) {
+    size_t slash = path.find_last_of('/');
+    string dir = slash == string::npos ? "." : path.substr(0, slash);
+    int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd < 0) {
+        return false;
+    }
+    bool ok = ::fsync(dirFd) == 0;
+    ::close(dirFd);
+    return ok;
+}
+
+#endif
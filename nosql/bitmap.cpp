@@ -0,0 +1,279 @@
+#include "bitmap.h"
+#include <algorithm>
+
+static uint32_t popcount64(uint64_t word) {
+    return (uint32_t)__builtin_popcountll(word);
+}
+
+bool Bitmap::Container::contains(uint16_t low) const {
+    if (isBitset()) {
+        return (bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return array.size() > 0 && std::binary_search(&array[0], &array[0] + array.size(), low);
+}
+
+void Bitmap::Container::toBitset() {
+    bits.reserve(BITSET_WORDS);
+    for (size_t i = 0; i < BITSET_WORDS; i++) {
+        bits.push_back(0);
+    }
+    for (size_t i = 0; i < array.size(); i++) {
+        bits[array[i] >> 6] |= 1ull << (array[i] & 63);
+    }
+    array.clear();
+}
+
+void Bitmap::Container::toArray() {
+    array.reserve(cardinality);
+    for (size_t w = 0; w < BITSET_WORDS; w++) {
+        uint64_t word = bits[w];
+        while (word) {
+            array.push_back((uint16_t)(w * 64 + __builtin_ctzll(word)));
+            word &= word - 1;
+        }
+    }
+    bits.clear();
+}
+
+void Bitmap::Container::intersectWith(const Container& other) {
+    if (isBitset() && other.isBitset()) {
+        cardinality = 0;
+        for (size_t w = 0; w < BITSET_WORDS; w++) {
+            bits[w] &= other.bits[w];
+            cardinality += popcount64(bits[w]);
+        }
+        if (cardinality <= ARRAY_LIMIT) {
+            toArray();
+        }
+        return;
+    }
+    if (isBitset()) {
+        //результат не больше массива other, он и остается
+        Vector<uint16_t> kept;
+        for (size_t i = 0; i < other.array.size(); i++) {
+            if (contains(other.array[i])) kept.push_back(other.array[i]);
+        }
+        bits.clear();
+        array = std::move(kept);
+    } else {
+        size_t kept = 0;
+        for (size_t i = 0; i < array.size(); i++) {
+            if (other.contains(array[i])) array[kept++] = array[i];
+        }
+        array.erase(kept, array.size());
+    }
+    cardinality = (uint32_t)array.size();
+}
+
+void Bitmap::Container::uniteWith(const Container& other) {
+    if (!isBitset() && !other.isBitset() && array.size() + other.array.size() <= ARRAY_LIMIT) {
+        Vector<uint16_t> merged;
+        merged.reserve(array.size() + other.array.size());
+        size_t i = 0, j = 0;
+        while (i < array.size() || j < other.array.size()) {
+            if (j >= other.array.size() || (i < array.size() && array[i] < other.array[j])) {
+                merged.push_back(array[i++]);
+            } else if (i >= array.size() || other.array[j] < array[i]) {
+                merged.push_back(other.array[j++]);
+            } else {
+                merged.push_back(array[i]);
+                i++;
+                j++;
+            }
+        }
+        array = std::move(merged);
+        cardinality = (uint32_t)array.size();
+        return;
+    }
+    if (!isBitset()) {
+        toBitset();
+    }
+    if (other.isBitset()) {
+        for (size_t w = 0; w < BITSET_WORDS; w++) {
+            bits[w] |= other.bits[w];
+        }
+    } else {
+        for (size_t i = 0; i < other.array.size(); i++) {
+            bits[other.array[i] >> 6] |= 1ull << (other.array[i] & 63);
+        }
+    }
+    cardinality = 0;
+    for (size_t w = 0; w < BITSET_WORDS; w++) {
+        cardinality += popcount64(bits[w]);
+    }
+    if (cardinality <= ARRAY_LIMIT) {
+        toArray();
+    }
+}
+
+//первый контейнер с key не меньше заданного
+size_t Bitmap::lowerBound(uint16_t key) const {
+    size_t first = 0, last = containers.size();
+    while (first < last) {
+        size_t middle = (first + last) / 2;
+        if (containers[middle].key < key) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+void Bitmap::add(uint32_t position) {
+    uint16_t key = (uint16_t)(position >> 16);
+    uint16_t low = (uint16_t)(position & 0xFFFF);
+    size_t at = containers.empty() || containers.back().key < key ? containers.size() : lowerBound(key);
+    if (at == containers.size() || containers[at].key != key) {
+        Container fresh;
+        fresh.key = key;
+        if (at == containers.size()) {
+            containers.push_back(std::move(fresh));
+        } else {
+            containers.insert(at, &fresh, &fresh + 1);
+        }
+    }
+    Container& container = containers[at];
+    if (container.isBitset()) {
+        uint64_t& word = container.bits[low >> 6];
+        uint64_t bit = 1ull << (low & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            container.cardinality++;
+        }
+        return;
+    }
+    Vector<uint16_t>& array = container.array;
+    if (array.empty() || array.back() < low) {
+        array.push_back(low);//обычный случай: номера растут
+    } else {
+        size_t place = std::lower_bound(&array[0], &array[0] + array.size(), low) - &array[0];
+        if (array[place] == low) return;
+        array.insert(place, &low, &low + 1);
+    }
+    container.cardinality++;
+    if (container.cardinality > ARRAY_LIMIT) {
+        container.toBitset();
+    }
+}
+
+void Bitmap::remove(uint32_t position) {
+    uint16_t key = (uint16_t)(position >> 16);
+    uint16_t low = (uint16_t)(position & 0xFFFF);
+    size_t at = lowerBound(key);
+    if (at == containers.size() || containers[at].key != key) return;
+    Container& container = containers[at];
+    if (container.isBitset()) {
+        uint64_t& word = container.bits[low >> 6];
+        uint64_t bit = 1ull << (low & 63);
+        if (!(word & bit)) return;
+        word &= ~bit;
+        container.cardinality--;
+        if (container.cardinality <= ARRAY_LIMIT / 2) {//половина предела - без дребезга на границе
+            container.toArray();
+        }
+    } else {
+        Vector<uint16_t>& array = container.array;
+        if (array.empty()) return;
+        size_t place = std::lower_bound(&array[0], &array[0] + array.size(), low) - &array[0];
+        if (place == array.size() || array[place] != low) return;
+        array.erase(place, place + 1);
+        container.cardinality--;
+    }
+    if (container.cardinality == 0) {
+        containers.erase(at, at + 1);
+    }
+}
+
+bool Bitmap::contains(uint32_t position) const {
+    uint16_t key = (uint16_t)(position >> 16);
+    size_t at = lowerBound(key);
+    return at < containers.size() && containers[at].key == key &&
+           containers[at].contains((uint16_t)(position & 0xFFFF));
+}
+
+size_t Bitmap::cardinality() const {
+    size_t total = 0;
+    for (size_t i = 0; i < containers.size(); i++) {
+        total += containers[i].cardinality;
+    }
+    return total;
+}
+
+void Bitmap::intersectWith(const Bitmap& other) {
+    size_t kept = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < containers.size(); i++) {
+        while (j < other.containers.size() && other.containers[j].key < containers[i].key) j++;
+        if (j == other.containers.size()) break;
+        if (other.containers[j].key != containers[i].key) continue;
+        containers[i].intersectWith(other.containers[j]);
+        if (containers[i].cardinality == 0) continue;
+        if (kept != i) {
+            containers[kept] = std::move(containers[i]);
+        }
+        kept++;
+    }
+    containers.erase(kept, containers.size());
+}
+
+void Bitmap::uniteWith(const Bitmap& other) {
+    Vector<Container> merged;
+    merged.reserve(containers.size() + other.containers.size());
+    size_t i = 0, j = 0;
+    while (i < containers.size() || j < other.containers.size()) {
+        if (j >= other.containers.size() ||
+            (i < containers.size() && containers[i].key < other.containers[j].key)) {
+            merged.push_back(std::move(containers[i++]));
+        } else if (i >= containers.size() || other.containers[j].key < containers[i].key) {
+            merged.push_back(other.containers[j++]);
+        } else {
+            containers[i].uniteWith(other.containers[j++]);
+            merged.push_back(std::move(containers[i++]));
+        }
+    }
+    containers = std::move(merged);
+}
+
+void Bitmap::toPositions(Vector<uint32_t>& out, size_t skip, size_t limit) const {
+    out.clear();
+    for (size_t c = 0; c < containers.size() && out.size() < limit; c++) {
+        const Container& container = containers[c];
+        if (skip >= container.cardinality) {
+            skip -= container.cardinality;//весь контейнер до нужного места, считать по счетчику
+            continue;
+        }
+        uint32_t high = (uint32_t)container.key << 16;
+        if (!container.isBitset()) {
+            for (size_t i = skip; i < container.array.size() && out.size() < limit; i++) {
+                out.push_back(high | container.array[i]);
+            }
+            skip = 0;
+            continue;
+        }
+        for (size_t w = 0; w < BITSET_WORDS && out.size() < limit; w++) {
+            uint64_t word = container.bits[w];
+            uint32_t count = popcount64(word);
+            if (skip >= count) {
+                skip -= count;
+                continue;
+            }
+            while (word && out.size() < limit) {
+                if (skip > 0) {
+                    skip--;
+                } else {
+                    out.push_back(high | (uint32_t)(w * 64 + __builtin_ctzll(word)));
+                }
+                word &= word - 1;
+            }
+        }
+    }
+}
+
+size_t Bitmap::memoryBytes() const {
+    size_t bytes = containers.memoryBytes();
+    for (size_t i = 0; i < containers.size(); i++) {
+        bytes += containers[i].array.memoryBytes() + containers[i].bits.memoryBytes();
+    }
+    return bytes;
+}
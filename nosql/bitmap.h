@@ -0,0 +1,50 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include "vector.h"
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+//сжатое множество номеров в стиле roaring: номера делятся по старшим 16 битам на контейнеры,
+//в контейнере до ARRAY_LIMIT значений - отсортированный массив младших 16 бит,
+//больше - битовая карта на 2^16 бит (8 КБ), так плотные и редкие значения обходятся дешево
+class Bitmap {
+private:
+    static const size_t ARRAY_LIMIT = 4096;
+    static const size_t BITSET_WORDS = 1024;
+
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        Vector<uint16_t> array;//пока значений не больше ARRAY_LIMIT
+        Vector<uint64_t> bits;//BITSET_WORDS слов, когда значений больше
+
+        bool isBitset() const { return !bits.empty(); }
+        bool contains(uint16_t low) const;
+        void toBitset();
+        void toArray();
+        void intersectWith(const Container& other);
+        void uniteWith(const Container& other);
+    };
+
+    Vector<Container> containers;//по возрастанию key
+
+    size_t lowerBound(uint16_t key) const;
+
+public:
+    void add(uint32_t position);
+    void remove(uint32_t position);
+    bool contains(uint32_t position) const;
+    size_t cardinality() const;
+    bool empty() const { return containers.empty(); }
+    void clear() { containers.clear(); }
+
+    void intersectWith(const Bitmap& other);
+    void uniteWith(const Bitmap& other);
+    //номера по возрастанию, первые skip пропускаются, не больше limit штук
+    void toPositions(Vector<uint32_t>& out, size_t skip = 0, size_t limit = (size_t)-1) const;
+    size_t memoryBytes() const;
+};
+
+#endif
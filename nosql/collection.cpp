@@ -1,19 +1,208 @@
 #include "collection.h"
 #include "JsonParser.h"
+#include "segment.h"
+#include "binary_io.h"
 #include <fstream>
 #include <cstdio>
 #include <string>
 #include <algorithm>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <ctime>
+#include <cmath>
+#include <condition_variable>
+#include <chrono>
 
-Collection::Collection(const string& collectionName) : name(collectionName) {
-    loadFromDisk();
+static const char* HEX_DIGITS = "0123456789abcdef";
+
+//ключ раздела в имени файла: буквы, цифры и '-' как есть, остальное _XX
+static string encodePartitionKey(const string& key) {
+    string out;
+    for (size_t i = 0; i < key.size(); i++) {
+        unsigned char c = key[i];
+        if (isalnum(c) || c == '-') {
+            out += (char)c;
+        } else {
+            out += '_';
+            out += HEX_DIGITS[c >> 4];
+            out += HEX_DIGITS[c & 0xF];
+        }
+    }
+    return out;
+}
+
+//цифра из HEX_DIGITS или -1: других имен encodePartitionKey не выдает
+static int hexDigitValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+//false для чужих имен, такой файл пропускается
+static bool decodePartitionKey(const string& encoded, string& key) {
+    key.clear();
+    for (size_t i = 0; i < encoded.size(); i++) {
+        if (encoded[i] != '_') {
+            key += encoded[i];
+            continue;
+        }
+        if (i + 2 >= encoded.size()) return false;
+        int high = hexDigitValue(encoded[i + 1]);
+        int low = hexDigitValue(encoded[i + 2]);
+        if (high < 0 || low < 0) return false;
+        key += (char)(high * 16 + low);
+        i += 2;
+    }
+    return true;
+}
+
+//ключи нечисловых id старых данных: верхняя половина, с числовыми не пересекаются
+static const uint64_t LEGACY_ID_BIT = 1ull << 63;
+
+//числовой id: только цифры, без ведущих нулей, меньше 2^63
+static bool parseNumericId(const string& id, uint64_t& out) {
+    if (id.empty() || id.size() > 19 || (id[0] == '0' && id.size() > 1)) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < id.size(); i++) {
+        if (id[i] < '0' || id[i] > '9') return false;
+        value = value * 10 + (uint64_t)(id[i] - '0');
+    }
+    if (value & LEGACY_ID_BIT) return false;
+    out = value;
+    return true;
+}
+
+string CollectionOptions::partitionKey(const HashMap<string, string>& data) const {
+    if (!isPartitioned()) return "";
+    string value;
+    if (!data.get(partitionField, value) || value.length() < partitionKeyLength) {
+        return "";//без метки времени - в общий раздел, он не отсекается
+    }
+    return value.substr(0, partitionKeyLength);
+}
+
+string CollectionOptions::partitionKey(const Document& doc) const {
+    if (!isPartitioned()) return "";
+    string value;
+    if (!doc.getField(partitionField, value) || value.length() < partitionKeyLength) {
+        return "";
+    }
+    return value.substr(0, partitionKeyLength);
+}
+
+int CollectionOptions::findIndex(const string& field) const {
+    for (size_t i = 0; i < indexes.size(); i++) {
+        if (indexes[i].field == field) return (int)i;
+    }
+    return -1;
+}
+
+string CollectionOptions::toJson() const {
+    string granularity = partitionKeyLength == 13 ? "hour" : "day";
+    //индексы одной строкой: "поле:тип,поле:тип"
+    string indexList;
+    for (size_t i = 0; i < indexes.size(); i++) {
+        if (i > 0) indexList += ",";
+        indexList += indexes[i].field + ":" + indexTypeName(indexes[i].type);
+    }
+    return "{\"partition_by\":\"" + partitionField + "\",\"granularity\":\"" + granularity +
+           "\",\"retention_days\":\"" + to_string(retentionDays) + "\",\"indexes\":\"" + indexList + "\"}";
+}
+
+static const int MAX_RETENTION_DAYS = 100 * 366;//сто лет
+
+bool CollectionOptions::fromMap(const HashMap<string, string>& map, CollectionOptions& inout, string& error) {
+    CollectionOptions result = inout;
+    map.get("partition_by", result.partitionField);
+    string granularity;
+    if (map.get("granularity", granularity)) {
+        if (granularity == "day") {
+            result.partitionKeyLength = 10;//YYYY-MM-DD
+        } else if (granularity == "hour") {
+            result.partitionKeyLength = 13;//YYYY-MM-DDTHH
+        } else {
+            error = "Unknown partition granularity: " + granularity;
+            return false;
+        }
+    }
+    string retention;
+    if (map.get("retention_days", retention)) {
+        //только целое число дней: дробь не отбрасывается молча, большое значение не переполняет int
+        double days = 0;
+        if (!Document::parseNumber(retention, days) || days < 0 || days > MAX_RETENTION_DAYS ||
+            days != std::floor(days)) {
+            error = "Invalid retention_days: " + retention;
+            return false;
+        }
+        result.retentionDays = (int)days;
+    }
+    string indexList;
+    if (map.get("indexes", indexList)) {
+        result.indexes.clear();
+        size_t start = 0;
+        while (start < indexList.size()) {
+            size_t end = indexList.find(',', start);
+            if (end == string::npos) end = indexList.size();
+            string item = indexList.substr(start, end - start);
+            start = end + 1;
+            if (item.empty()) continue;
+            IndexSpec spec;
+            size_t colon = item.find(':');
+            spec.field = item.substr(0, colon);
+            if (colon != string::npos && !parseIndexType(item.substr(colon + 1), spec.type)) {
+                error = "Unknown index type: " + item.substr(colon + 1);
+                return false;
+            }
+            if (spec.field.empty() || result.findIndex(spec.field) >= 0) {
+                error = "Invalid or duplicate index field in: " + indexList;
+                return false;
+            }
+            result.indexes.push_back(spec);
+        }
+    }
+    if (result.retentionDays > 0 && !result.isPartitioned()) {
+        //срок хранения работает удалением разделов целиком
+        error = "retention_days requires partition_by";
+        return false;
+    }
+    if (result.retentionDays > 0 && result.partitionField != "timestamp") {
+        //ключи разделов сравниваются с датой YYYY-MM-DD, у других полей это не даты
+        error = "retention_days requires partition_by timestamp";
+        return false;
+    }
+    inout = result;
+    return true;
+}
+
+Collection::Collection(const string& collectionName, ThreadPool* loader)
+    : name(collectionName), documentCount(0), wal(collectionName + ".wal"), nextId(1), savedNextId(1) {
+    loadOptions();
+    loadFromDisk(loader);//поля индексов привязываются там, после словарей сегментов
 }
 
-bool Collection::loadFromDisk() {
-    string filename = getFilename();
+Collection::~Collection() {
+    for (const auto& entry : partitions) {
+        delete entry.value;
+    }
+}
+
+Partition::~Partition() {
+    for (size_t i = 0; i < indexes.size(); i++) {
+        delete indexes[i];
+    }
+}
+
+//JSON-массив документов: старый формат снимка и формат выгрузки
+//документы без _id получают номера начиная с nextId, после всех числовых id файла
+static bool readJsonFile(const string& filename, Vector<Document>& out, FieldDictionary& fields, uint64_t& nextId) {
     std::ifstream file(filename.c_str());
     if (!file.is_open()) {
-        return true;
+        return false;
     }
     
     string jsonContent;
@@ -29,141 +218,866 @@ bool Collection::loadFromDisk() {
     if (jsonContent.empty()) {
         return true;
     }
-    
+    size_t last = jsonContent.find_last_not_of(" \t\r\n");
+    if (last == string::npos || jsonContent[last] != ']') {
+        //файл обрезан при записи: берем что разобралось, но не молча
+        cerr << "[COLLECTION][ERROR] Truncated JSON in " << filename
+             << ", documents after the cut are lost" << endl;
+    }
+
     //парсинг массива доков
     JsonParser parser;
     Vector<HashMap<string, string>> documentsArray = parser.parseArray(jsonContent);
-
-    documents.clear();
     
+    string docId;
+    uint64_t number;
+    for (size_t i = 0; i < documentsArray.size(); i++) {
+        if (documentsArray[i].get("_id", docId) && parseNumericId(docId, number) && number >= nextId) {
+            nextId = number + 1;
+        }
+    }
+    out.reserve(out.size() + documentsArray.size());
     for (size_t i = 0; i < documentsArray.size(); i++) {//загрузка доков из массива
-        HashMap<string, string> docData = documentsArray[i];
-        string docId;
-        
-        if (!docData.get("_id", docId)) {
-            static int counter = 0;
-            docId = "doc_" + to_string(counter++);
+        if (!documentsArray[i].get("_id", docId)) {
+            docId = to_string(nextId++);
         }
-        
-        Document doc(docData, docId);//создаем документ объекты в хэш мап
-        documents.put(docId, doc);
+        out.emplace_back(documentsArray[i], docId, fields);
     }
-    
     return true;
 }
 
-bool Collection::saveToDisk() {
-    string filename = getFilename();
-    std::ofstream file(filename.c_str());
-    if (!file.is_open()) {
+//перестраивать арену, когда мусора больше половины и больше этого
+static const size_t ARENA_REBUILD_MIN_WASTE = 16 * 1024 * 1024;
+
+//документов на одну задачу разбора сегмента
+static const size_t LOAD_CHUNK_SIZE = 8192;
+
+bool Collection::loadFromDisk(ThreadPool* loader) {
+    for (const auto& entry : partitions) {
+        delete entry.value;
+    }
+    partitions.clear();
+    documentCount = 0;
+    arena.reset();
+
+    //сегменты: <коллекция>.seg для общего раздела и <коллекция>.p.<ключ>.seg
+    string dir = ".";
+    string base = name;
+    size_t slash = name.find_last_of('/');
+    if (slash != string::npos) {
+        dir = name.substr(0, slash);
+        base = name.substr(slash + 1);
+    }
+    Vector<pair<string, string>> segmentFiles;//ключ раздела, путь
+    DIR* dirHandle = opendir(dir.c_str());
+    if (dirHandle) {
+        struct dirent* entry;
+        string partPrefix = base + ".p.";
+        while ((entry = readdir(dirHandle)) != nullptr) {
+            string file = entry->d_name;
+            string key;
+            if (file == base + ".seg") {
+                segmentFiles.push_back(make_pair(string(""), dir + "/" + file));
+            } else if (file.size() > partPrefix.size() + 4 &&
+                       file.compare(0, partPrefix.size(), partPrefix) == 0 &&
+                       file.compare(file.size() - 4, 4, ".seg") == 0 &&
+                       decodePartitionKey(file.substr(partPrefix.size(), file.size() - partPrefix.size() - 4), key)) {
+                segmentFiles.push_back(make_pair(key, dir + "/" + file));
+            }
+        }
+        closedir(dirHandle);
+    }
+
+    //последние снимки разделов, по таблице смещений режутся на куски
+    //сегмент со словарем остается отображенным, его документы - виды на блоки: при открытии
+    //читаются только заголовки блоков, значения подгружаются страницами при обращении;
+    //словари привязываются до разбора старых сегментов и журнала, чтобы номера полей совпали
+    Vector<shared_ptr<SegmentReader>> segments;
+    Vector<uint8_t> mapped;//не 0 - документы файла берутся видами
+    Vector<size_t> chunkFile, chunkBegin;
+    for (size_t f = 0; f < segmentFiles.size(); f++) {
+        shared_ptr<SegmentReader> segment = make_shared<SegmentReader>();
+        segments.push_back(segment);
+        mapped.push_back(0);
+        if (!segment->open(segmentFiles[f].second)) continue;
+        Partition* partition = getPartition(segmentFiles[f].first, true);
+        if (!partition->segment && segment->bindDictionary(fields)) {
+            partition->segment = segment;
+            mapped[f] = 1;
+        }
+        for (size_t begin = 0; begin < segment->count(); begin += LOAD_CHUNK_SIZE) {
+            chunkFile.push_back(f);
+            chunkBegin.push_back(begin);
+        }
+    }
+    bindIndexFields();
+
+    //разбор идет параллельно, в разделы куски кладутся строго по номеру, чтобы сохранить порядок вставки;
+    //parallelFor раздает номера по возрастанию, поэтому предыдущий кусок всегда уже у кого-то в работе
+    Vector<string> misplaced;//документ не в своем файле (сменилось разбиение)
+    mutex putMutex;
+    condition_variable putTurn;
+    size_t nextChunk = 0;
+    auto loadChunk = [&](size_t c) {
+        size_t f = chunkFile[c];
+        const SegmentReader* segment = segments[f].get();
+        size_t end = std::min(chunkBegin[c] + LOAD_CHUNK_SIZE, segment->count());
+        Vector<Document> docs;
+        Vector<string> keys;
+        for (size_t i = chunkBegin[c]; i < end; i++) {
+            Document doc;
+            if (mapped[f] ? segment->view(i, doc, fields) : segment->document(i, doc, fields)) {
+                keys.push_back(options.partitionKey(doc));
+                docs.push_back(std::move(doc));
+            }
+        }
+        unique_lock<mutex> lock(putMutex);
+        putTurn.wait(lock, [&]() { return nextChunk == c; });
+        for (size_t i = 0; i < docs.size(); i++) {
+            if (keys[i] != segmentFiles[f].first) {
+                misplaced.push_back(segmentFiles[f].first);
+                misplaced.push_back(keys[i]);
+                if (mapped[f]) {
+                    docs[i] = docs[i].copyTo(arena);//чужой раздел не держит это отображение
+                }
+            }
+            putDocument(std::move(docs[i]), keys[i]);
+        }
+        nextChunk++;
+        putTurn.notify_all();
+    };
+    if (loader && chunkFile.size() > 1) {
+        loader->parallelFor(chunkFile.size(), loadChunk);
+    } else {
+        for (size_t c = 0; c < chunkFile.size(); c++) {
+            loadChunk(c);
+        }
+    }
+    segments.clear();//отображения остаются только у разделов, которые их держат
+
+    if (segmentFiles.empty()) {
+        //снимок старого формата, заменится сегментами при первом сжатии
+        Vector<Document> legacy;
+        readJsonFile(getJsonFilename(), legacy, fields, nextId);
+        for (size_t i = 0; i < legacy.size(); i++) {
+            string key = options.partitionKey(legacy[i]);
+            putDocument(std::move(legacy[i]), key);
+        }
+    } else {
+        //загруженное из сегментов уже на диске, переписать только перепутанные разделы
+        for (const auto& entry : partitions) {
+            entry.value->dirty = false;
+        }
+        for (size_t i = 0; i < misplaced.size(); i++) {
+            getPartition(misplaced[i], true)->dirty = true;
+        }
+    }
+
+    //поверх снимка накатываем журнал, сначала недосжатый если остался
+    auto apply = [this](WalOp op, const string& payload) {
+        applyWalRecord(op, payload);
+    };
+    size_t frozenBytes = 0, frozenRecords = 0;
+    bool ok = WriteAheadLog::recover(getFrozenWalFilename(), apply, frozenBytes, frozenRecords);
+    return wal.replay(apply) && ok;
+}
+
+Partition* Collection::getPartition(const string& key, bool create) {
+    Partition* partition = nullptr;
+    if (!partitions.get(key, partition) && create) {
+        partition = new Partition();
+        partition->key = key;
+        for (size_t i = 0; i < options.indexes.size(); i++) {
+            partition->indexes.push_back(PartitionIndex::create(options.indexes[i].type));
+        }
+        partitions.put(key, partition);
+    }
+    return partition;
+}
+
+//ключ id для positions; create - выдать ключ новому нечисловому id
+bool Collection::idKey(const string& id, bool create, uint64_t& key) {
+    if (parseNumericId(id, key)) {
+        return true;
+    }
+    if (legacyKeys.get(id, key)) {
+        return true;
+    }
+    if (!create) {
         return false;
     }
-    
-    file << "[" << std::endl;
-    auto items = documents.items();
-    bool first = true;
-    
-    for (size_t i = 0; i < items.size(); i++) {
-        if (!first) {
-            file << "," << std::endl;
+    key = LEGACY_ID_BIT | legacyKeys.size();
+    legacyKeys.put(id, key);
+    return true;
+}
+
+void Collection::putDocument(Document&& doc, const string& partitionKey) {
+    Partition* partition = getPartition(partitionKey, true);
+    uint64_t key;
+    idKey(doc.getId(), true, key);
+    if (key < LEGACY_ID_BIT && key >= nextId) {
+        nextId = key + 1;//id из журнала, сегмента или импорта больше не выдается
+    }
+    if (doc.ownsBlock()) {
+        doc = doc.copyTo(arena);//вид может указывать только в сегмент этого же раздела
+    }
+    uint32_t position;
+    if (!partition->positions.get(key, position)) {
+        position = (uint32_t)partition->documents.size();
+        partition->positions.put(key, position);
+        partition->documents.push_back(std::move(doc));
+        partition->ids.push_back(key);
+        partition->deleted.push_back(0);
+        documentCount++;
+        indexDocument(partition, position, true);
+    } else {
+        //новая версия встает на место старой, старая остается в арене до перестройки
+        if (!partition->isMapped(partition->documents[position])) {
+            arena.release(partition->documents[position].byteSize());
+        }
+        indexDocument(partition, position, false);
+        partition->documents[position] = std::move(doc);
+        indexDocument(partition, position, true);
+        if (partition->deleted[position]) {
+            partition->deleted[position] = 0;//повторная вставка удаленного id
+            partition->deletedCount--;
+            documentCount++;
+        }
+    }
+    partition->dirty = true;
+}
+
+//значения документа во всех индексах раздела
+void Collection::indexDocument(Partition* partition, size_t position, bool add) {
+    string value;
+    const Document& doc = partition->documents[position];
+    for (size_t i = 0; i < partition->indexes.size(); i++) {
+        if (!doc.getFieldById(indexFieldIds[i], value)) continue;//без поля в индекс не попадает
+        if (add) {
+            partition->indexes[i]->add(value, (uint32_t)position);
+        } else {
+            partition->indexes[i]->remove(value, (uint32_t)position);
+        }
+    }
+}
+
+//индексы заново по живым документам раздела, набор индексов - по options
+void Collection::rebuildIndexes(Partition* partition) {
+    for (size_t i = 0; i < partition->indexes.size(); i++) {
+        delete partition->indexes[i];
+    }
+    partition->indexes.clear();
+    for (size_t i = 0; i < options.indexes.size(); i++) {
+        partition->indexes.push_back(PartitionIndex::create(options.indexes[i].type));
+    }
+    for (size_t i = 0; i < partition->documents.size(); i++) {
+        if (!partition->isDeleted(i)) {
+            indexDocument(partition, i, true);
+        }
+    }
+}
+
+void Collection::bindIndexFields() {
+    indexFieldIds.clear();
+    for (size_t i = 0; i < options.indexes.size(); i++) {
+        indexFieldIds.push_back(fields.intern(options.indexes[i].field));
+    }
+}
+
+void Collection::applyWalRecord(WalOp op, const string& payload) {
+    if (op == WalOp::INSERT) {
+        Document doc;
+        if (Document::deserialize(payload.data(), payload.size(), doc, fields)) {
+            string key = options.partitionKey(doc);
+            putDocument(std::move(doc), key);
+        }
+    } else if (op == WalOp::DROP_PARTITION) {
+        dropPartition(payload);
+    } else if (op == WalOp::DELETE) {
+        Partition* partition;
+        uint32_t position;
+        if (locate(payload, partition, position)) {
+            markDeleted(partition, position);
+        }
+    }
+}
+
+//в записи журнала только id, раздел ищем перебором - удаления редки
+//только живой документ: надгробие того же id может лежать в разделе, откуда документ переехал
+bool Collection::locate(const string& id, Partition*& partition, uint32_t& position) {
+    uint64_t key;
+    if (!idKey(id, false, key)) return false;
+    for (const auto& entry : partitions) {
+        if (entry.value->positions.get(key, position) && !entry.value->isDeleted(position)) {
+            partition = entry.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Collection::discardInserted(const Vector<string>& ids) {
+    string records;
+    size_t count = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        Partition* partition;
+        uint32_t position;
+        if (locate(ids[i], partition, position) && markDeleted(partition, position)) {
+            WriteAheadLog::encodeRecord(records, WalOp::DELETE, ids[i]);
+            count++;
+        }
+    }
+    //сжатие могло уже взять документы в снимок: удаления в журнал, без ожидания
+    if (count > 0) {
+        wal.enqueue(records, count);
+    }
+}
+
+//документ остается в памяти до сжатия, сканы его пропускают
+bool Collection::markDeleted(Partition* partition, size_t position) {
+    if (partition->deleted[position]) {
+        return false;
+    }
+    partition->deleted[position] = 1;
+    partition->deletedCount++;
+    partition->dirty = true;
+    documentCount--;
+    string value;
+    for (size_t i = 0; i < partition->indexes.size(); i++) {
+        //точные индексы отвечают без проверки документов, удаленный должен уйти из них сразу
+        if (partition->indexes[i]->exact() &&
+            partition->documents[position].getFieldById(indexFieldIds[i], value)) {
+            partition->indexes[i]->remove(value, (uint32_t)position);
         }
-        string jsonStr = items[i].second.to_json();
-        file << " " << jsonStr.c_str();
-        first = false;
     }
-    file << "]" << std::endl;
-    file.close();
     return true;
 }
 
-string Collection::getFilename() const {
+size_t Collection::dropPartition(const string& key) {
+    size_t dropped = 0;
+    Partition* partition = getPartition(key, false);
+    if (partition) {
+        dropped = partition->liveCount();
+        documentCount -= dropped;
+        for (const auto& doc : partition->documents) {
+            if (!partition->isMapped(doc)) {
+                arena.release(doc.byteSize());
+            }
+        }
+        partitions.remove(key);
+        delete partition;
+    }
+    std::remove(getSegmentFilename(key).c_str());//удаление файла вместо перебора документов
+    return dropped;
+}
+
+size_t Collection::applyRetention(time_t now, Vector<string>& droppedKeys) {
+    if (options.retentionDays <= 0 || !options.isPartitioned()) {
+        return 0;
+    }
+
+    time_t cutoffTime = now - (time_t)options.retentionDays * 24 * 60 * 60;
+    char cutoff[16];
+    struct tm cutoffTm;
+    gmtime_r(&cutoffTime, &cutoffTm);
+    strftime(cutoff, sizeof(cutoff), "%Y-%m-%d", &cutoffTm);
+
+    string records;
+    for (const auto& entry : partitions) {
+        const string& key = entry.key;
+        if (!key.empty() && key.compare(0, 10, cutoff) < 0) {
+            droppedKeys.push_back(key);
+            WriteAheadLog::encodeRecord(records, WalOp::DROP_PARTITION, key);
+        }
+    }
+    if (droppedKeys.empty()) {
+        return 0;
+    }
+
+    //сначала запись в журнале, иначе после рестарта раздел восстановится из журнала
+    if (!wal.commit(wal.enqueue(records, droppedKeys.size()), true)) {
+        droppedKeys.clear();
+        return 0;
+    }
+
+    size_t dropped = 0;
+    for (size_t i = 0; i < droppedKeys.size(); i++) {
+        dropped += dropPartition(droppedKeys[i]);
+    }
+    return dropped;
+}
+
+//границы по полю разбиения из $gt/$lt/$eq/$like верхнего уровня и вложенных $and
+//exact - обязательные префиксы значения
+static void collectPartitionBounds(const QueryCondition& condition, const string& field,
+                                   Vector<string>& lower, Vector<string>& upper, Vector<string>& exact) {
+    double number;
+    switch (condition.type) {
+        case ConditionType::AND:
+            for (size_t i = 0; i < condition.subConditions.size(); i++) {
+                collectPartitionBounds(condition.subConditions[i], field, lower, upper, exact);
+            }
+            break;
+        case ConditionType::LIKE:
+            //"2026-10-16%" - значение обязано начинаться с литерального префикса
+            if (condition.field == field) {
+                size_t wildcard = condition.value.find_first_of("%_");
+                string prefix = condition.value.substr(0, wildcard);
+                if (!prefix.empty()) {
+                    exact.push_back(prefix);
+                }
+            }
+            break;
+        case ConditionType::GREATER_THAN:
+            //числа сравниваются как числа, по префиксу строки их не отсечь
+            if (condition.field == field && !Document::parseNumber(condition.value, number)) {
+                lower.push_back(field == "timestamp" ? Document::timestampBound(condition.value, true) : condition.value);
+            }
+            break;
+        case ConditionType::LESS_THAN:
+            if (condition.field == field && !Document::parseNumber(condition.value, number)) {
+                upper.push_back(field == "timestamp" ? Document::timestampBound(condition.value, false) : condition.value);
+            }
+            break;
+        case ConditionType::EQUAL:
+            if (condition.field == field) {
+                exact.push_back(condition.value);
+            }
+            break;
+        default:
+            break;//$or/$in/$like не сужают диапазон
+    }
+}
+
+//разделы, в которых могут быть подходящие документы, по возрастанию ключа
+Vector<Partition*> Collection::partitionsFor(const QueryCondition& condition) const {
+    Vector<string> lower, upper, exact;
+    if (options.isPartitioned()) {
+        collectPartitionBounds(condition, options.partitionField, lower, upper, exact);
+    }
+
+    Vector<Partition*> result;
+    for (const auto& entry : partitions) {
+        const string& key = entry.key;
+        bool mayMatch = true;
+        if (!key.empty()) {//общий раздел не отсекается
+            //все значения раздела начинаются с key
+            for (size_t j = 0; j < lower.size() && mayMatch; j++) {
+                if (key < lower[j].substr(0, key.size())) mayMatch = false;
+            }
+            for (size_t j = 0; j < upper.size() && mayMatch; j++) {
+                if (key > upper[j].substr(0, key.size())) mayMatch = false;
+            }
+            for (size_t j = 0; j < exact.size() && mayMatch; j++) {
+                size_t common = std::min(key.size(), exact[j].size());
+                if (exact[j].compare(0, common, key, 0, common) != 0) mayMatch = false;
+            }
+        }
+        if (mayMatch) {
+            result.push_back(entry.value);
+        }
+    }
+
+    if (result.size() > 1) {
+        std::sort(&result[0], &result[0] + result.size(), [](const Partition* a, const Partition* b) {
+            return a->key < b->key;
+        });
+    }
+    return result;
+}
+
+string Collection::getSegmentFilename(const string& partitionKey) const {
+    if (partitionKey.empty()) {
+        return name + ".seg";
+    }
+    return name + ".p." + encodePartitionKey(partitionKey) + ".seg";
+}
+
+string Collection::getJsonFilename() const {
     return name + ".json";
 }
 
-string Collection::insert(const string& jsonData) {
+string Collection::getFrozenWalFilename() const {
+    return name + ".wal.compacting";
+}
+
+string Collection::getOptionsFilename() const {
+    return name + ".meta";
+}
+
+bool Collection::loadOptions() {
+    std::ifstream file(getOptionsFilename().c_str());
+    if (!file.is_open()) {
+        return true;//настроек нет - коллекция без разбиения
+    }
+    string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
     JsonParser parser;
-    HashMap<string, string> newDocData = parser.parse(jsonData);
+    HashMap<string, string> map = parser.parse(content);
+    string error;
+    if (!CollectionOptions::fromMap(map, options, error)) {
+        cerr << "[COLLECTION][ERROR] Bad options in " << getOptionsFilename() << ": " << error << endl;
+        return false;
+    }
+    //граница выданных id: документ с последним id мог быть удален и сжат
+    string savedId;
+    uint64_t value;
+    if (map.get("next_id", savedId) && parseNumericId(savedId, value) && value > nextId) {
+        nextId = value;
+        savedNextId = value;
+    }
+    return true;
+}
 
-    static int counter = 0;
-    string docId = "doc_" + to_string(static_cast<int>(std::time(nullptr))) + 
-                   "_" + to_string(std::rand() % 10000) + "_" + to_string(counter++);
+bool Collection::saveOptions() const {
+    string filename = getOptionsFilename();
+    string tmpFilename = filename + ".tmp";
+    int fd = ::open(tmpFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    string json = options.toJson();
+    json.insert(json.size() - 1, ",\"next_id\":\"" + to_string(nextId) + "\"");
+    bool ok = writeFully(fd, json + "\n") && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmpFilename.c_str());
+        return false;
+    }
+    return fsyncDirectoryOf(filename);
+}
 
-    newDocData.put("_id", docId);
-    
-    Document newDoc(newDocData, docId);
-    documents.put(docId, newDoc);
-    
-    if (saveToDisk()) {
+static bool sameIndexes(const Vector<IndexSpec>& a, const Vector<IndexSpec>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].field != b[i].field || a[i].type != b[i].type) return false;
+    }
+    return true;
+}
+
+bool Collection::setOptions(const CollectionOptions& newOptions) {
+    bool repartition = newOptions.partitionField != options.partitionField ||
+                       newOptions.partitionKeyLength != options.partitionKeyLength;
+    bool reindex = !sameIndexes(newOptions.indexes, options.indexes);
+    CollectionOptions previous = options;
+    options = newOptions;
+    if (!saveOptions()) {
+        options = std::move(previous);//в памяти остается то, что лежит в .meta
+        return false;
+    }
+    bindIndexFields();
+    if (!repartition) {
+        if (reindex) {
+            for (const auto& entry : partitions) {
+                rebuildIndexes(entry.value);
+            }
+        }
+        return true;
+    }
+
+    //раскладываем документы по новым разделам, файлы перепишет сжатие
+    //живые документы идут по возрастанию id, так в новых разделах сохраняется порядок вставки
+    auto oldPartitions = partitions.items();
+    partitions.clear();
+    documentCount = 0;
+    Vector<pair<uint64_t, Document*>> live;
+    for (size_t i = 0; i < oldPartitions.size(); i++) {
+        Partition* old = oldPartitions[i].second;
+        getPartition(old->key, true)->dirty = true;//старый файл будет переписан или удален
+        for (size_t j = 0; j < old->documents.size(); j++) {
+            if (!old->isDeleted(j)) {//надгробия не переносим
+                live.push_back(make_pair(old->ids[j], &old->documents[j]));
+            }
+        }
+    }
+    if (live.size() > 1) {
+        std::sort(&live[0], &live[0] + live.size(), [](const pair<uint64_t, Document*>& a,
+                                                      const pair<uint64_t, Document*>& b) {
+            return a.first < b.first;
+        });
+    }
+    for (size_t i = 0; i < live.size(); i++) {
+        string key = options.partitionKey(*live[i].second);
+        putDocument(std::move(*live[i].second), key);
+    }
+    for (size_t i = 0; i < oldPartitions.size(); i++) {
+        delete oldPartitions[i].second;
+    }
+    return true;
+}
+
+bool Collection::createIndex(const IndexSpec& spec, string& error) {
+    if (spec.field.empty()) {
+        error = "Index field is required";
+        return false;
+    }
+    if (options.findIndex(spec.field) >= 0) {
+        error = "Index on " + spec.field + " already exists";
+        return false;
+    }
+    options.indexes.push_back(spec);
+    if (!saveOptions()) {
+        options.indexes.pop_back();
+        error = "Failed to save options for collection " + name;
+        return false;
+    }
+    bindIndexFields();
+
+    //строится только новый индекс, остальные уже заполнены
+    uint32_t fieldId = indexFieldIds.back();
+    string value;
+    for (const auto& entry : partitions) {
+        Partition* partition = entry.value;
+        PartitionIndex* index = PartitionIndex::create(spec.type);
+        partition->indexes.push_back(index);
+        for (size_t i = 0; i < partition->documents.size(); i++) {
+            if (!partition->isDeleted(i) && partition->documents[i].getFieldById(fieldId, value)) {
+                index->add(value, (uint32_t)i);
+            }
+        }
+    }
+    return true;
+}
+
+string Collection::insert(const string& jsonData) {
+    JsonParser parser;
+    Vector<HashMap<string, string>> batch;
+    batch.push_back(parser.parse(jsonData));
+
+    Vector<string> insertedIds;
+    if (commit(insertBatch(batch, insertedIds), DurabilityMode::FSYNC)) {
         return string("Document inserted successfully.");
     } else {
+        discardInserted(insertedIds);
         return string("Error: Failed to save document to disk.");
     }
 }
 
-Vector<Document> Collection::find(const QueryCondition& condition) {
-    Vector<Document> results;
-    auto items = documents.items();//все доки коллекции
-    
-    for (size_t i = 0; i < items.size(); i++) {
-        if (items[i].second.matchesCondition(condition)) {
-            results.push_back(items[i].second);//добавляем подходящие доки
+uint64_t Collection::insertBatch(const Vector<HashMap<string, string>>& batch, Vector<string>& insertedIds,
+                                 DurabilityMode mode) {
+    string records;
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        string docId = to_string(nextId++);
+
+        //_id из присланных полей не берется, в блоке он всегда в заголовке
+        Document newDoc(batch[i], docId, fields);
+        if (mode != DurabilityMode::NONE) {
+            WriteAheadLog::encodeRecord(records, WalOp::INSERT, newDoc.serialize());
         }
+        string key = options.partitionKey(newDoc);
+        putDocument(std::move(newDoc), key);
+        insertedIds.push_back(docId);
     }
-    return results;
+
+    if (mode == DurabilityMode::NONE || batch.size() == 0) {
+        return 0;//нечего ждать
+    }
+    return wal.enqueue(records, batch.size());
 }
 
-Vector<Document> Collection::find(const QueryCondition& condition, int page, int limit) {
-    Vector<Document> allResults;
-    auto items = documents.items();//все доки коллекции
-    
-    for (size_t i = 0; i < items.size(); i++) {
-        if (items[i].second.matchesCondition(condition)) {
-            allResults.push_back(items[i].second);//добавляем подходящие доки
+bool Collection::commit(uint64_t sequence, DurabilityMode mode) {
+    if (sequence == 0 || mode != DurabilityMode::FSYNC) {
+        return true;//async и none сбросит фоновый поток
+    }
+    return wal.commit(sequence, true);
+}
+
+bool Collection::flush() {
+    return wal.flush(true);
+}
+
+//копия условия с номерами полей и разделы, в которых могут быть совпадения
+Vector<Partition*> Collection::prepareQuery(const QueryCondition& condition, QueryCondition& bound) const {
+    bound = condition;
+    fields.bind(bound);//имена полей в номера один раз на запрос
+    QueryPlanner::orderPredicates(bound);
+    return partitionsFor(condition);//только разделы в диапазоне
+}
+
+PlanNode Collection::planPartition(const Partition* partition, const QueryCondition& bound) const {
+    return QueryPlanner(options, indexFieldIds, *partition).plan(bound);
+}
+
+//false - visit попросил остановиться; examined - сколько документов проверено условием
+bool Collection::scanPartition(Partition* partition, const QueryCondition& bound, const PlanNode& plan,
+                               Vector<uint32_t>& positions,
+                               const function<bool(Partition*, size_t, const Document&)>& visit, size_t* examined) {
+    size_t checked = 0;
+    bool completed = true;
+    if (plan.kind != PlanKind::FULL_SCAN) {
+        //по индексу только кандидаты, условие целиком проверяется, если ответ не точный;
+        //при диапазоне по упорядоченному индексу документы идут в порядке его значений
+        QueryPlanner(options, indexFieldIds, *partition).candidates(plan, positions);
+        bool exact = plan.exact;
+        for (size_t j = 0; j < positions.size() && completed; j++) {
+            size_t i = positions[j];
+            if (!exact && partition->isDeleted(i)) continue;
+            const Document& doc = partition->documents[i];
+            if (!exact) checked++;
+            if ((exact || doc.matchesCondition(bound)) && !visit(partition, i, doc)) {
+                completed = false;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < partition->documents.size() && completed; i++) {
+            if (partition->isDeleted(i)) continue;
+            const Document& doc = partition->documents[i];
+            checked++;
+            if (doc.matchesCondition(bound) && !visit(partition, i, doc)) {
+                completed = false;
+            }
         }
     }
-    
-    // Применяем пагинацию
-    if (page > 0 && limit > 0) {
-        int start_index = (page - 1) * limit;
-        int end_index = std::min(start_index + limit, (int)allResults.size());
-        
-        if (start_index >= (int)allResults.size()) {
-            return Vector<Document>(); // Пустой результат, если страница за пределами
+    if (examined) *examined += checked;
+    return completed;
+}
+
+void Collection::scanPartitions(const QueryCondition& condition,
+                                const function<bool(Partition*, size_t, const Document&)>& visit) {
+    QueryCondition bound;
+    Vector<Partition*> candidates = prepareQuery(condition, bound);
+    Vector<uint32_t> positions;
+    for (size_t p = 0; p < candidates.size(); p++) {
+        PlanNode plan = planPartition(candidates[p], bound);
+        if (!scanPartition(candidates[p], bound, plan, positions, visit)) {
+            return;
         }
-        
-        Vector<Document> paginatedResults;
-        for (int i = start_index; i < end_index; i++) {
-            paginatedResults.push_back(allResults[i]);
+    }
+}
+
+void Collection::scan(const QueryCondition& condition, const function<bool(const Document&)>& visit) {
+    scanPartitions(condition, [&visit](Partition*, size_t, const Document& doc) {
+        return visit(doc);
+    });
+}
+
+Vector<Document> Collection::find(const QueryCondition& condition) {
+    Vector<Document> results;
+    scan(condition, [&results](const Document& doc) {
+        results.push_back(doc);//вид на блок в арене, сами данные не копируются
+        return true;
+    });
+    return results;
+}
+
+Vector<Document> Collection::find(const QueryCondition& condition, int page, int limit, size_t* totalCount) {
+    if (page <= 0 || limit <= 0) {
+        Vector<Document> allResults = find(condition);
+        if (totalCount) *totalCount = allResults.size();
+        return allResults;
+    }
+
+    //документы до страницы только считаются, в результат идут лишь limit штук
+    size_t first = (size_t)(page - 1) * limit;
+    size_t last = first + limit;
+    size_t matched = 0;
+    Vector<Document> pageResults;
+    auto visit = [&](Partition*, size_t, const Document& doc) {
+        if (matched >= first && matched < last) {
+            pageResults.push_back(doc);
+        }
+        matched++;
+        return totalCount != nullptr || matched < last;
+    };
+
+    QueryCondition bound;
+    Vector<Partition*> candidates = prepareQuery(condition, bound);
+    Vector<uint32_t> positions;
+    Bitmap exactMatches;
+    for (size_t p = 0; p < candidates.size(); p++) {
+        Partition* partition = candidates[p];
+        PlanNode plan = planPartition(partition, bound);
+        if (plan.exact) {
+            //совпадения раздела известны точно: число - мощность карты, документы - только со страницы
+            QueryPlanner(options, indexFieldIds, *partition).bitmapMatches(plan, exactMatches);
+            size_t found = exactMatches.cardinality();
+            if (matched + found > first && matched < last) {
+                size_t skip = first > matched ? first - matched : 0;
+                exactMatches.toPositions(positions, skip, last - matched - skip);
+                for (size_t i = 0; i < positions.size(); i++) {
+                    pageResults.push_back(partition->documents[positions[i]]);
+                }
+            }
+            matched += found;
+        } else if (!scanPartition(partition, bound, plan, positions, visit)) {
+            break;
+        }
+        if (!totalCount && matched >= last) {
+            break;
         }
-        return paginatedResults;
     }
-    
-    return allResults;
+    if (totalCount) *totalCount = matched;
+    return pageResults;
 }
 
 size_t Collection::count(const QueryCondition& condition) {
     size_t count = 0;
-    auto items = documents.items();
-    
-    for (size_t i = 0; i < items.size(); i++) {
-        if (items[i].second.matchesCondition(condition)) {
-            count++;
+    QueryCondition bound;
+    Vector<Partition*> candidates = prepareQuery(condition, bound);
+    Vector<uint32_t> positions;
+    Bitmap exactMatches;
+    for (size_t p = 0; p < candidates.size(); p++) {
+        PlanNode plan = planPartition(candidates[p], bound);
+        if (plan.exact) {
+            QueryPlanner(options, indexFieldIds, *candidates[p]).bitmapMatches(plan, exactMatches);
+            count += exactMatches.cardinality();//без обращения к документам
+            continue;
         }
+        scanPartition(candidates[p], bound, plan, positions, [&count](Partition*, size_t, const Document&) {
+            count++;
+            return true;
+        });
     }
-    
     return count;
 }
 
-string Collection::remove(const QueryCondition& condition) {
-    Vector<Document> toRemove = find(condition);// находим что удалить
-    size_t count = toRemove.size();
-    
-    for (size_t i = 0; i < toRemove.size(); i++) {
-        documents.remove(toRemove[i].getId());//удаляем из памяти
+Vector<PartitionExplain> Collection::explain(const QueryCondition& condition, string& filter) {
+    Vector<PartitionExplain> result;
+    QueryCondition bound;
+    Vector<Partition*> candidates = prepareQuery(condition, bound);
+    filter = QueryPlanner::describeCondition(bound);
+    Vector<uint32_t> positions;
+    for (size_t p = 0; p < candidates.size(); p++) {
+        Partition* partition = candidates[p];
+        PartitionExplain entry;
+        entry.key = partition->key;
+        entry.documents = partition->liveCount();
+
+        auto startTime = chrono::steady_clock::now();
+        QueryPlanner planner(options, indexFieldIds, *partition);
+        PlanNode plan = planner.plan(bound);
+        auto plannedTime = chrono::steady_clock::now();
+        scanPartition(partition, bound, plan, positions, [&entry](Partition*, size_t, const Document&) {
+            entry.matchedRows++;
+            return true;
+        }, &entry.examinedRows);
+        auto doneTime = chrono::steady_clock::now();
+
+        entry.plan = planner.describe(plan);
+        entry.estimatedRows = plan.estimate;
+        entry.planMs = chrono::duration<double, milli>(plannedTime - startTime).count();
+        entry.executeMs = chrono::duration<double, milli>(doneTime - plannedTime).count();
+        result.push_back(std::move(entry));
     }
+    return result;
+}
+
+string Collection::remove(const QueryCondition& condition, DurabilityMode mode) {
+    size_t count = 0;
+    string records;
+    //только пометки удаления, физически документы уберет сжатие
+    scanPartitions(condition, [&](Partition* partition, size_t position, const Document& doc) {
+        if (markDeleted(partition, position)) {
+            WriteAheadLog::encodeRecord(records, WalOp::DELETE, doc.getId());
+            count++;
+        }
+        return true;
+    });
     
     if (count > 0) {
-        if (saveToDisk()) {
+        //надгробия пишутся и в режиме none, как в async: иначе удаленное вернется из сегмента после рестарта
+        uint64_t sequence = wal.enqueue(records, count);
+        if (commit(sequence, mode)) {
             return to_string(count) + string(" document(s) deleted successfully.");
         } else {
             return string("Error: Failed to save changes to disk.");
@@ -174,5 +1088,294 @@ string Collection::remove(const QueryCondition& condition) {
 }
 
 size_t Collection::size() const {
-    return documents.size();
-}
\ No newline at end of file
+    return documentCount;
+}
+
+CollectionMemory Collection::memoryUsage() const {
+    CollectionMemory usage;
+    usage.documentBytes = arena.bytesReserved();
+    usage.wastedBytes = arena.bytesWasted();
+    usage.indexBytes = partitions.memoryBytes() + legacyKeys.memoryBytes();
+    for (const auto& entry : partitions) {
+        const Partition* partition = entry.value;
+        usage.mappedBytes += partition->segment ? partition->segment->mappedBytes() : 0;
+        usage.indexBytes += sizeof(Partition) + partition->documents.memoryBytes() +
+                            partition->ids.memoryBytes() + partition->deleted.memoryBytes() +
+                            partition->positions.memoryBytes() + partition->indexes.memoryBytes();
+        for (size_t i = 0; i < partition->indexes.size(); i++) {
+            usage.indexBytes += partition->indexes[i]->memoryBytes();
+        }
+    }
+    return usage;
+}
+
+//сжатие целиком под мьютексом бд: вызывается перед выгрузкой, когда коллекцией никто не пользуется
+bool Collection::spill() {
+    if (!wal.flush(true)) {
+        return false;
+    }
+    bool dirty = false;
+    for (const auto& entry : partitions) {
+        dirty = dirty || entry.value->dirty;
+    }
+    if (!dirty) {
+        return true;//все уже в сегментах
+    }
+    Vector<PartitionSnapshot> snapshot;
+    if (!beginCompaction(snapshot)) {
+        return false;
+    }
+    bool written = writeSnapshot(snapshot);
+    finishCompaction(snapshot, written);
+    return written;
+}
+
+bool Collection::needsCompaction(const CompactionPolicy& policy) const {
+    return wal.sizeBytes() >= policy.maxWalBytes ||
+           wal.records() >= policy.maxWalRecords;
+}
+
+bool Collection::beginCompaction(Vector<PartitionSnapshot>& snapshot) {
+    //прошлое сжатие не дописалось - возвращаем его журнал на место
+    struct stat st;
+    if (stat(getFrozenWalFilename().c_str(), &st) == 0) {
+        if (!wal.unrotate(getFrozenWalFilename())) {
+            return false;
+        }
+    }
+
+    //граница id в .meta до ротации: после сжатия удаленные документы с последними id пропадут с диска
+    if (nextId != savedNextId) {
+        if (!saveOptions()) {
+            cerr << "[COLLECTION][ERROR] Failed to save next id to " << getOptionsFilename() << endl;
+            return false;
+        }
+        savedNextId = nextId;
+    }
+
+    if (!wal.rotate(getFrozenWalFilename())) {
+        return false;
+    }
+
+    //все изменения из замороженного журнала лежат в разделах с dirty
+    for (const auto& partitionEntry : partitions) {
+        Partition* partition = partitionEntry.value;
+        if (!partition->dirty) continue;
+        PartitionSnapshot part;
+        part.key = partition->key;
+        part.segment = partition->segment;
+        part.documents.reserve(partition->liveCount());
+        part.ids.reserve(partition->liveCount());
+        for (size_t i = 0; i < partition->documents.size(); i++) {
+            if (partition->isDeleted(i)) {
+                part.purged.push_back(partition->ids[i]);
+            } else {
+                part.documents.push_back(partition->documents[i]);
+                part.ids.push_back(partition->ids[i]);
+            }
+        }
+        snapshot.push_back(part);
+        partition->dirty = false;
+    }
+    return true;
+}
+
+bool Collection::writeSnapshot(const Vector<PartitionSnapshot>& snapshot) const {
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        string filename = getSegmentFilename(snapshot[i].key);
+        if (snapshot[i].documents.empty()) {
+            std::remove(filename.c_str());//раздел опустел
+            continue;
+        }
+        if (!SegmentWriter::write(filename, snapshot[i].documents, fields)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Collection::finishCompaction(const Vector<PartitionSnapshot>& snapshot, bool snapshotWritten) {
+    if (!snapshotWritten) {
+        //замороженный журнал остается и вернется в beginCompaction
+        for (size_t i = 0; i < snapshot.size(); i++) {
+            getPartition(snapshot[i].key, true)->dirty = true;
+        }
+        return;
+    }
+
+    std::remove(getFrozenWalFilename().c_str());
+    std::remove(getJsonFilename().c_str());//старый снимок больше не нужен
+
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        Partition* partition = getPartition(snapshot[i].key, false);
+        if (!partition) continue;
+        purgePartition(partition, snapshot[i].purged);
+        remapPartition(partition, snapshot[i]);
+        if (!partition->dirty && partition->documents.size() == 0) {
+            partitions.remove(snapshot[i].key);
+            delete partition;
+        }
+    }
+
+    //снимок записан и больше не читается - можно перенести живые документы в новую арену
+    if (arena.bytesWasted() > ARENA_REBUILD_MIN_WASTE && arena.bytesWasted() * 2 > arena.bytesUsed()) {
+        rebuildArena();
+    }
+}
+
+//удаленных уже нет в сегменте - освобождаем память, порядок остальных сохраняется
+//id, вставленный заново после начала сжатия, уже не помечен и не трогается
+void Collection::purgePartition(Partition* partition, const Vector<uint64_t>& purged) {
+    static const uint8_t PURGED = 2;
+    size_t purgedCount = 0;
+    uint32_t position;
+    for (size_t j = 0; j < purged.size(); j++) {
+        if (partition->positions.get(purged[j], position) && partition->deleted[position]) {
+            partition->deleted[position] = PURGED;
+            purgedCount++;
+        }
+    }
+    if (purgedCount == 0) {
+        return;
+    }
+
+    size_t total = partition->documents.size();
+    size_t kept = 0;
+    for (size_t i = 0; i < total; i++) {
+        if (partition->deleted[i] == PURGED) {
+            if (!partition->isMapped(partition->documents[i])) {
+                arena.release(partition->documents[i].byteSize());
+            }
+            continue;
+        }
+        if (kept != i) {
+            partition->documents[kept] = std::move(partition->documents[i]);
+            partition->ids[kept] = partition->ids[i];
+            partition->deleted[kept] = partition->deleted[i];
+        }
+        kept++;
+    }
+    partition->documents.erase(kept, total);
+    partition->ids.erase(kept, total);
+    partition->deleted.erase(kept, total);
+    partition->deletedCount -= purgedCount;
+
+    //номера сдвинулись - индекс строится заново
+    partition->positions.clear();
+    for (size_t i = 0; i < kept; i++) {
+        partition->positions.put(partition->ids[i], (uint32_t)i);
+    }
+    rebuildIndexes(partition);
+}
+
+//записанные документы теперь лежат в новом сегменте раздела: неизмененные с начала сжатия
+//становятся видами на его блоки, их место в арене освобождается; прежнее отображение
+//отпускается, что еще в него указывало - копируется в арену
+void Collection::remapPartition(Partition* partition, const PartitionSnapshot& written) {
+    shared_ptr<SegmentReader> segment;
+    if (!written.documents.empty()) {
+        segment = make_shared<SegmentReader>();
+        if (!segment->open(getSegmentFilename(written.key)) || segment->count() != written.documents.size() ||
+            !segment->bindDictionary(fields)) {
+            segment.reset();//документы остаются в памяти, как до сегментов
+        }
+    }
+    shared_ptr<SegmentReader> previous = partition->segment;
+    uint32_t position;
+    for (size_t j = 0; segment && j < written.documents.size(); j++) {
+        Document view;
+        if (!partition->positions.get(written.ids[j], position) ||
+            partition->documents[position].bytes() != written.documents[j].bytes() ||
+            !segment->view(j, view, fields)) {
+            continue;//заменен после начала сжатия
+        }
+        if (!partition->isMapped(partition->documents[position])) {
+            arena.release(partition->documents[position].byteSize());
+        }
+        partition->documents[position] = std::move(view);
+    }
+    for (size_t i = 0; previous && i < partition->documents.size(); i++) {
+        if (previous->contains(partition->documents[i].bytes())) {
+            partition->documents[i] = partition->documents[i].copyTo(arena);
+        }
+    }
+    partition->segment = segment;
+}
+
+void Collection::rebuildArena() {
+    Arena fresh;
+    for (const auto& partitionEntry : partitions) {
+        Partition* partition = partitionEntry.value;
+        for (auto& doc : partition->documents) {
+            if (!partition->isMapped(doc)) {
+                doc = doc.copyTo(fresh);
+            }
+        }
+    }
+    arena.swap(fresh);//старые блоки освобождаются вместе с fresh
+}
+
+bool Collection::exportJson(const string& filename) const {
+    std::ofstream file(filename.c_str());
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    file << "[" << std::endl;
+    bool first = true;
+    for (const auto& partitionEntry : partitions) {
+        const Partition* partition = partitionEntry.value;
+        for (size_t i = 0; i < partition->documents.size(); i++) {
+            if (partition->isDeleted(i)) continue;
+            if (!first) {
+                file << "," << std::endl;
+            }
+            file << " " << partition->documents[i].to_json();
+            first = false;
+        }
+    }
+    file << "]" << std::endl;
+    file.close();
+    return !file.fail();
+}
+
+string Collection::importJson(const string& filename, DurabilityMode mode) {
+    Vector<Document> imported;
+    if (!readJsonFile(filename, imported, fields, nextId)) {
+        return "Error: Cannot open " + filename;
+    }
+
+    string records;
+    size_t recordCount = 0;
+    Vector<string> addedIds;//без замененных: их прежние версии уже не вернуть
+    for (size_t i = 0; i < imported.size(); i++) {
+        const string& id = imported[i].getId();
+        string key = options.partitionKey(imported[i]);
+        Partition* existing;
+        uint32_t position;
+        if (!locate(id, existing, position)) {
+            addedIds.push_back(id);
+        } else if (existing != getPartition(key, false)) {
+            //сменилась метка времени: putDocument заменяет только в своем разделе, старая копия
+            //удаляется явно, и запись DELETE идет раньше INSERT, чтобы восстановление повторило то же
+            markDeleted(existing, position);
+            WriteAheadLog::encodeRecord(records, WalOp::DELETE, id);
+            recordCount++;
+        }
+        if (mode != DurabilityMode::NONE) {
+            WriteAheadLog::encodeRecord(records, WalOp::INSERT, imported[i].serialize());
+            recordCount++;
+        }
+        putDocument(std::move(imported[i]), key);//_id из файла сохраняется
+    }
+
+    uint64_t sequence = 0;
+    if (recordCount > 0) {
+        sequence = wal.enqueue(records, recordCount);
+    }
+    if (!commit(sequence, mode)) {
+        discardInserted(addedIds);
+        return string("Error: Failed to save imported documents to disk.");
+    }
+    return to_string(imported.size()) + string(" document(s) imported successfully.");
+}
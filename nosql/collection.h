@@ -5,28 +5,191 @@
 #include "HashMap.h"
 #include "vector.h"
 #include "QueryCondition.h"
+#include "wal.h"
+#include "thread_pool.h"
+#include "index.h"
+#include "query_planner.h"
+#include "segment.h"
 #include <string>
+#include <functional>
+#include <memory>
 
 using namespace std;
 
+//когда сворачивать журнал в новый снимок
+struct CompactionPolicy {
+    size_t maxWalBytes = 64 * 1024 * 1024;
+    size_t maxWalRecords = 100000;
+    int checkIntervalSec = 5;
+};
+
+//настройки коллекции, хранятся в <коллекция>.meta
+struct CollectionOptions {
+    string partitionField;//пусто - коллекция без разбиения
+    size_t partitionKeyLength = 10;//префикс значения: 10 - по дням, 13 - по часам
+    int retentionDays = 0;//0 - хранить всегда, иначе разделы старше удаляются целиком
+    Vector<IndexSpec> indexes;//строятся при загрузке, на диске только список
+
+    bool isPartitioned() const { return !partitionField.empty(); }
+    int findIndex(const string& field) const;//-1, если индекса по полю нет
+    string partitionKey(const HashMap<string, string>& data) const;
+    string partitionKey(const Document& doc) const;
+    string toJson() const;
+    //меняет только ключи, которые есть в map
+    static bool fromMap(const HashMap<string, string>& map, CollectionOptions& inout, string& error);
+};
+
+//часть коллекции с общим префиксом метки времени, у каждой свой сегмент
+//документы лежат в порядке вставки, поиск по id - через целочисленный ключ
+struct Partition {
+    string key;
+    Vector<Document> documents;//блоки лежат в арене коллекции или в отображении segment
+    Vector<uint64_t> ids;//ключ id каждого документа, в том же порядке
+    Vector<uint8_t> deleted;//не 0 - удален, но лежит в documents до сжатия
+    HashMap<uint64_t, uint32_t> positions;//ключ id -> номер в documents
+    Vector<PartitionIndex*> indexes;//по одному на CollectionOptions::indexes, в том же порядке
+    size_t deletedCount = 0;
+    bool dirty = false;//есть изменения, которых нет в сегменте
+    //последний сегмент раздела: непрочитанные и неизмененные документы - виды на его блоки,
+    //в арену документ попадает только новой версией
+    shared_ptr<SegmentReader> segment;
+
+    Partition() = default;
+    ~Partition();
+    Partition(const Partition&) = delete;
+    Partition& operator=(const Partition&) = delete;
+
+    size_t liveCount() const { return documents.size() - deletedCount; }
+    bool isDeleted(size_t position) const {
+        return deletedCount > 0 && deleted[position] != 0;
+    }
+    bool isMapped(const Document& doc) const {
+        return segment && segment->contains(doc.bytes());
+    }
+};
+
+struct PartitionSnapshot {
+    string key;
+    Vector<Document> documents;//только живые документы, в порядке вставки
+    Vector<uint64_t> ids;//ключи documents
+    Vector<uint64_t> purged;//ключи надгробий, которые уберутся из памяти после записи
+    shared_ptr<SegmentReader> segment;//виды в documents читаются при записи без мьютекса
+};
+
+//память коллекции в байтах, без словаря полей (он ограничен по размеру)
+struct CollectionMemory {
+    size_t documentBytes = 0;//арена: взято у системы под блоки документов
+    size_t wastedBytes = 0;//из них занято удаленными и замененными версиями
+    size_t indexBytes = 0;//массивы разделов, индексы id и вторичные индексы полей
+    size_t mappedBytes = 0;//отображенные сегменты: страничный кеш, в total не входит
+
+    size_t total() const { return documentBytes + indexBytes; }
+};
+
+//как запрос выполнился в одном разделе, для explain
+struct PartitionExplain {
+    string key;
+    string plan;
+    size_t documents = 0;//живых в разделе
+    size_t estimatedRows = 0;//кандидатов по оценке планировщика
+    size_t examinedRows = 0;//документов, проверенных условием
+    size_t matchedRows = 0;
+    double planMs = 0;
+    double executeMs = 0;
+};
+
 class Collection {
 private:
     string name;
-    HashMap<string, Document> documents;
-    
-    string getFilename() const;
-    bool saveToDisk();
-    
+    CollectionOptions options;
+    HashMap<string, Partition*> partitions;
+    size_t documentCount;
+    FieldDictionary fields;//имена полей всех документов коллекции
+    Arena arena;//блоки документов, освобождаются только перестройкой
+    WriteAheadLog wal;//изменения после последнего снимка
+    uint64_t nextId;//следующий выдаваемый id, после удалений не уменьшается
+    uint64_t savedNextId;//значение, записанное в .meta
+    HashMap<string, uint64_t> legacyKeys;//нечисловые id старых данных -> ключ из верхней половины
+    Vector<uint32_t> indexFieldIds;//номера полей options.indexes в словаре
+
+    string getSegmentFilename(const string& partitionKey) const;
+    string getJsonFilename() const;
+    string getFrozenWalFilename() const;
+    string getOptionsFilename() const;
+    bool loadOptions();
+    bool saveOptions() const;
+    Partition* getPartition(const string& key, bool create);
+    Vector<Partition*> partitionsFor(const QueryCondition& condition) const;
+    bool idKey(const string& id, bool create, uint64_t& key);
+    bool locate(const string& id, Partition*& partition, uint32_t& position);
+    void scanPartitions(const QueryCondition& condition,
+                        const function<bool(Partition*, size_t, const Document&)>& visit);
+    void putDocument(Document&& doc, const string& partitionKey);
+    void indexDocument(Partition* partition, size_t position, bool add);
+    void rebuildIndexes(Partition* partition);
+    void bindIndexFields();
+    Vector<Partition*> prepareQuery(const QueryCondition& condition, QueryCondition& bound) const;
+    PlanNode planPartition(const Partition* partition, const QueryCondition& bound) const;
+    bool scanPartition(Partition* partition, const QueryCondition& bound, const PlanNode& plan,
+                       Vector<uint32_t>& positions, const function<bool(Partition*, size_t, const Document&)>& visit,
+                       size_t* examined = nullptr);
+    bool markDeleted(Partition* partition, size_t position);
+    void purgePartition(Partition* partition, const Vector<uint64_t>& purged);
+    void remapPartition(Partition* partition, const PartitionSnapshot& written);
+    size_t dropPartition(const string& key);
+    void applyWalRecord(WalOp op, const string& payload);
+    void rebuildArena();
+
 public:
-    Collection(const string& collectionName);
-    
-    bool loadFromDisk();
+    //с пулом сегменты разбираются кусками параллельно
+    Collection(const string& collectionName, ThreadPool* loader = nullptr);
+    ~Collection();
+    Collection(const Collection&) = delete;
+    Collection& operator=(const Collection&) = delete;
+
+    bool loadFromDisk(ThreadPool* loader = nullptr);
     string insert(const string& jsonData);
+    //вся пачка применяется в памяти и ставится в журнал одной записью
+    uint64_t insertBatch(const Vector<HashMap<string, string>>& batch, Vector<string>& insertedIds,
+                         DurabilityMode mode = DurabilityMode::FSYNC);
+    bool commit(uint64_t sequence, DurabilityMode mode);
+    //пачка, которую commit не записал, убирается из памяти, чтобы не быть видимой без журнала
+    void discardInserted(const Vector<string>& ids);
+    bool flush();//фоновый сброс для async
+    //подходящие живые документы по ссылке, без копий, раздел за разделом в порядке вставки;
+    //visit возвращает false, чтобы остановить обход
+    void scan(const QueryCondition& condition, const function<bool(const Document&)>& visit);
     Vector<Document> find(const QueryCondition& condition);
-    Vector<Document> find(const QueryCondition& condition, int page, int limit);
+    //в результат попадает только страница; totalCount - все совпадения, без него обход кончается на странице
+    Vector<Document> find(const QueryCondition& condition, int page, int limit, size_t* totalCount = nullptr);
     size_t count(const QueryCondition& condition);
-    string remove(const QueryCondition& condition);
+    //выполняет запрос без выдачи документов: план, оценки и факт по каждому разделу;
+    //filter - условие в порядке, в котором его проверяют документы
+    Vector<PartitionExplain> explain(const QueryCondition& condition, string& filter);
+    string remove(const QueryCondition& condition, DurabilityMode mode = DurabilityMode::FSYNC);
     size_t size() const;
+    CollectionMemory memoryUsage() const;
+    //все изменения в сегменты: после этого объект можно удалить и загрузить заново без потерь
+    bool spill();
+
+    const CollectionOptions& getOptions() const { return options; }
+    bool setOptions(const CollectionOptions& newOptions);
+    //строит индекс по всем разделам и запоминает его в .meta
+    bool createIndex(const IndexSpec& spec, string& error);
+    size_t partitionCount() const { return partitions.size(); }
+    //удаляет разделы старше retentionDays, возвращает число удаленных документов
+    size_t applyRetention(time_t now, Vector<string>& droppedKeys);
+
+    //JSON остается форматом выгрузки и загрузки
+    bool exportJson(const string& filename) const;
+    string importJson(const string& filename, DurabilityMode mode);
+
+    //сжатие в три шага: копия под мьютексом бд, запись без него, завершение
+    //переписываются только измененные разделы
+    bool needsCompaction(const CompactionPolicy& policy) const;
+    bool beginCompaction(Vector<PartitionSnapshot>& snapshot);
+    bool writeSnapshot(const Vector<PartitionSnapshot>& snapshot) const;
+    void finishCompaction(const Vector<PartitionSnapshot>& snapshot, bool snapshotWritten);
 };
 
-#endif 
\ No newline at end of file
+#endif
@@ -1,6 +1,14 @@
 #include "database.h"
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <dirent.h>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+
+static int64_t steadyNowMs() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 
 Database::Database(const string& dbName) : name(dbName) {
@@ -8,9 +16,8 @@ Database::Database(const string& dbName) : name(dbName) {
 }
 
 Database::~Database() {
-    auto items = collections.items();
-    for (size_t i = 0; i < items.size(); i++) {
-        delete items[i].second;
+    for (const auto& entry : collections) {
+        delete entry.value;
     }
 }
 
@@ -26,6 +33,7 @@ void Database::ensureDirectory() {
 }
 
 Collection& Database::getCollection(const string& collectionName) {
+    lastAccess.put(collectionName, steadyNowMs());
     Collection* coll = nullptr;
     if (collections.get(collectionName, coll)) {
         return *coll;
@@ -37,3 +45,98 @@ Collection& Database::getCollection(const string& collectionName) {
         return *newCollection;
     }
 }
+
+
+Vector<Collection*> Database::getLoadedCollections() const {
+    Vector<Collection*> result;
+    for (const auto& entry : collections) {
+        result.push_back(entry.value);
+    }
+    return result;
+}
+
+//имя коллекции по файлу хранения, пусто если файл не ее
+static string collectionNameOf(const string& file) {
+    static const char* suffixes[] = {".wal.compacting", ".wal", ".seg", ".meta", ".json"};
+    if (file.empty() || file[0] == '.' || file.find(".tmp") != string::npos ||
+        file.find(".export.json") != string::npos) {
+        return "";
+    }
+    for (const char* suffix : suffixes) {
+        size_t len = strlen(suffix);
+        if (file.size() > len && file.compare(file.size() - len, len, suffix) == 0) {
+            string base = file.substr(0, file.size() - len);
+            size_t part = base.find(".p.");//сегмент раздела <коллекция>.p.<ключ>.seg
+            if (part != string::npos && strcmp(suffix, ".seg") == 0) {
+                base = base.substr(0, part);
+            }
+            return base;
+        }
+    }
+    return "";
+}
+
+size_t Database::preload(ThreadPool& pool) {
+    Vector<string> names;
+    HashMap<string, bool> seen;
+    DIR* dirHandle = opendir(name.c_str());
+    if (!dirHandle) {
+        return 0;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dirHandle)) != nullptr) {
+        string collectionName = collectionNameOf(entry->d_name);
+        if (!collectionName.empty() && !seen.contains(collectionName) &&
+            !collections.contains(collectionName)) {
+            seen.put(collectionName, true);
+            names.push_back(collectionName);
+        }
+    }
+    closedir(dirHandle);
+
+    Vector<Collection*> loaded;
+    for (size_t i = 0; i < names.size(); i++) {
+        loaded.push_back(nullptr);
+    }
+    pool.parallelFor(names.size(), [&](size_t i) {
+        loaded[i] = new Collection(name + "/" + names[i], &pool);
+    });
+
+    size_t documents = 0;
+    int64_t now = steadyNowMs();
+    for (size_t i = 0; i < names.size(); i++) {
+        collections.put(names[i], loaded[i]);
+        lastAccess.put(names[i], now);
+        documents += loaded[i]->size();
+    }
+    return documents;
+}
+
+Vector<CollectionUsage> Database::memoryUsage() const {
+    Vector<CollectionUsage> result;
+    for (const auto& entry : collections) {
+        CollectionUsage usage;
+        usage.name = entry.key;
+        usage.documents = entry.value->size();
+        usage.memory = entry.value->memoryUsage();
+        lastAccess.get(entry.key, usage.lastAccessMs);
+        result.push_back(std::move(usage));
+    }
+    return result;
+}
+
+bool Database::evict(const string& collectionName) {
+    Collection* coll = nullptr;
+    if (!collections.get(collectionName, coll)) {
+        return false;
+    }
+    if (!coll->spill()) {
+        cerr << "[DATABASE][ERROR] Failed to spill collection " << collectionName
+             << " in database " << name << ", keeping it in memory" << endl;
+        return false;
+    }
+    collections.remove(collectionName);
+    lastAccess.remove(collectionName);
+    delete coll;
+    return true;
+}
@@ -6,10 +6,19 @@
 #include <filesystem>
 using namespace std;
 
+//загруженная коллекция: сколько занимает и когда к ней обращались
+struct CollectionUsage {
+    string name;
+    size_t documents = 0;
+    CollectionMemory memory;
+    int64_t lastAccessMs = 0;//steady_clock
+};
+
 class Database {
 private:
     string name;
     HashMap<string, Collection*> collections;
+    HashMap<string, int64_t> lastAccess;//время последнего getCollection, мс steady_clock
     
     void ensureDirectory();
 
@@ -17,7 +26,15 @@ public:
     Database(const string& dbName);
     ~Database();
     Collection& getCollection(const string& collectionName);
+    Vector<Collection*> getLoadedCollections() const;
+    //загрузка всех коллекций каталога базы, возвращает число документов
+    size_t preload(ThreadPool& pool);
     string getName() const { return name; }
+
+    Vector<CollectionUsage> memoryUsage() const;
+    //сбрасывает коллекцию на диск и убирает из памяти, следующий getCollection загрузит ее заново
+    //указатели из getLoadedCollections после этого недействительны
+    bool evict(const string& collectionName);
 };
 
 #endif
@@ -12,25 +12,30 @@
 #include <memory>
 #include <mutex>
 #include <chrono>
+#include <algorithm>
 #include <arpa/inet.h>
 #include "JsonParser.h"
 #include "vector.h"
+#include "thread_pool.h"
+#include "arena.h"
+#include <dirent.h>
+#include <sys/stat.h>
 
 using namespace std;
 
-ConnectionManager::ConnectionManager() : running(false), serverSocket(-1) {
+ConnectionManager::ConnectionManager()
+    : running(false), serverSocket(-1),
+      defaultDurability(DurabilityMode::FSYNC), flushIntervalMs(1000), loadThreads(0), memoryLimit(0) {
 }
 
 ConnectionManager::~ConnectionManager() {
     stop();
-    auto dbItems = databases.items();
-    for (size_t i = 0; i < dbItems.size(); i++) {
-        delete dbItems[i].second;
+    for (const auto& entry : databases) {
+        delete entry.value;
     }
 
-    auto mutexItems = dbMutexes.items();
-    for (size_t i = 0; i < mutexItems.size(); i++) {
-        delete mutexItems[i].second;//очистка мьютексов
+    for (const auto& entry : dbMutexes) {
+        delete entry.value;//очистка мьютексов
     }
 }
 
@@ -61,6 +66,11 @@ bool ConnectionManager::start(int port, int numWorkers) {
         return false;
     }
 
+    //порт закрыт, пока идет загрузка: проверка здоровья пройдет только после нее
+    if (loadThreads > 0) {
+        preloadDatabases();
+    }
+
     if (listen(serverSocket, 10) < 0) {
         cerr << "[SERVER][ERROR] Failed to listen on socket, errno: " << errno << endl;
         close(serverSocket);
@@ -79,6 +89,9 @@ bool ConnectionManager::start(int port, int numWorkers) {
         workerThreads.push_back(thread(&ConnectionManager::workerThread, this));
     }
 
+    compactorThread = thread(&ConnectionManager::compactionLoop, this);
+    flusherThread = thread(&ConnectionManager::flushLoop, this);
+
     cout << "[SERVER][SUCCESS] Started on port " << port
          << " with " << numWorkers << " worker threads" << endl;
 
@@ -263,8 +276,18 @@ bool ConnectionManager::isValidJsonRequest(const string& jsonStr) {
 
 void ConnectionManager::stop() {
     if (!running) return;
-    running = false;
+    {
+        lock_guard<mutex> lock(compactorMutex);
+        running = false;
+    }
     queueCV.notify_all();
+    compactorCV.notify_all();
+    if (compactorThread.joinable()) {
+        compactorThread.join();
+    }
+    if (flusherThread.joinable()) {
+        flusherThread.join();
+    }
 
     for (size_t i = 0; i < workerThreads.size(); ++i) {//завершение рабочих потоков
         if (workerThreads[i].joinable()) {
@@ -277,6 +300,8 @@ void ConnectionManager::stop() {
         serverSocket = -1;
     }
 
+    flushAll();//async-записи не должны теряться при штатной остановке
+
     cout << "[SERVER] Stopped" << endl;
 }
 
@@ -304,24 +329,219 @@ void ConnectionManager::workerThread() {
     }
 }
 
+void ConnectionManager::compactionLoop() {
+    while (running) {
+        {
+            unique_lock<mutex> lock(compactorMutex);
+            compactorCV.wait_for(lock, chrono::seconds(compactionPolicy.checkIntervalSec),
+                                 [this]() { return !running; });
+        }
+        if (!running) break;
+
+        Vector<pair<Database*, mutex*>> targets = getOpenDatabases();
+        for (size_t i = 0; i < targets.size() && running; i++) {
+            compactDatabase(targets[i].first, targets[i].second);
+        }
+        if (running) {
+            enforceMemoryLimit();//после сжатия: выгружаемым коллекциям меньше писать
+        }
+    }
+}
+
+//все базы из рабочего каталога (каталог на базу) грузятся пулом потоков
+void ConnectionManager::preloadDatabases() {
+    auto startTime = chrono::steady_clock::now();
+    Vector<string> names;
+    DIR* dirHandle = opendir(".");
+    if (dirHandle) {
+        struct dirent* entry;
+        while ((entry = readdir(dirHandle)) != nullptr) {
+            string dirName = entry->d_name;
+            struct stat st;
+            if (dirName[0] != '.' && stat(dirName.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                names.push_back(dirName);
+            }
+        }
+        closedir(dirHandle);
+    }
+
+    Vector<Database*> loaded;
+    Vector<size_t> documents;
+    for (size_t i = 0; i < names.size(); i++) {
+        loaded.push_back(new Database(names[i]));
+        documents.push_back(0);
+    }
+
+    ThreadPool pool(loadThreads - 1);//вызывающий поток тоже работает
+    pool.parallelFor(names.size(), [&](size_t i) {
+        documents[i] = loaded[i]->preload(pool);
+    });
+
+    size_t collectionCount = 0, documentCount = 0;
+    {
+        lock_guard<mutex> lock(mapMutex);
+        for (size_t i = 0; i < names.size(); i++) {
+            databases.put(names[i], loaded[i]);
+            if (!dbMutexes.contains(names[i])) {
+                dbMutexes.put(names[i], new mutex());
+            }
+            collectionCount += loaded[i]->getLoadedCollections().size();
+            documentCount += documents[i];
+        }
+    }
+
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime);
+    cout << "[PRELOAD] Loaded " << documentCount << " document(s) in " << collectionCount
+         << " collection(s) of " << names.size() << " database(s) in " << elapsed.count()
+         << " ms using " << loadThreads << " thread(s)" << endl;
+}
+
+Vector<pair<Database*, mutex*>> ConnectionManager::getOpenDatabases() {
+    Vector<pair<Database*, mutex*>> targets;
+    lock_guard<mutex> lock(mapMutex);
+    for (const auto& entry : databases) {
+        mutex* mutexPtr = nullptr;
+        if (dbMutexes.get(entry.key, mutexPtr) && mutexPtr) {
+            targets.push_back(make_pair(entry.value, mutexPtr));
+        }
+    }
+    return targets;
+}
+
+void ConnectionManager::flushLoop() {
+    while (running) {
+        {
+            unique_lock<mutex> lock(compactorMutex);
+            compactorCV.wait_for(lock, chrono::milliseconds(flushIntervalMs),
+                                 [this]() { return !running; });
+        }
+        if (!running) break;
+        flushAll();
+    }
+}
+
+void ConnectionManager::flushAll() {
+    shared_lock<shared_timed_mutex> maintenance(maintenanceMutex);//коллекции не выгрузятся посреди сброса
+    Vector<pair<Database*, mutex*>> targets = getOpenDatabases();
+    for (size_t i = 0; i < targets.size(); i++) {
+        Vector<Collection*> collections;
+        {
+            lock_guard<mutex> lock(*targets[i].second);
+            collections = targets[i].first->getLoadedCollections();
+        }
+        for (size_t j = 0; j < collections.size(); j++) {
+            if (!collections[j]->flush()) {
+                cerr << "[FLUSHER][ERROR] Failed to flush log in database "
+                     << targets[i].first->getName() << endl;
+            }
+        }
+    }
+}
+
+bool ConnectionManager::resolveDurability(const Request& req, DurabilityMode& mode, string& error) {
+    if (!req.durability.empty()) {//запрос может переопределить режим бд
+        if (!parseDurabilityMode(req.durability, mode)) {
+            error = "Unknown durability mode: " + req.durability;
+            return false;
+        }
+        return true;
+    }
+    if (!databaseDurability.get(req.database, mode)) {
+        mode = defaultDurability;
+    }
+    return true;
+}
+
+void ConnectionManager::compactDatabase(Database* db, mutex* dbMutex) {
+    Vector<Collection*> collections;
+    {
+        lock_guard<mutex> lock(*dbMutex);
+        collections = db->getLoadedCollections();
+    }
+
+    for (size_t i = 0; i < collections.size(); i++) {
+        Collection* coll = collections[i];
+        {
+            //устаревшие разделы удаляются до сжатия, чтобы не переписывать их сегменты
+            lock_guard<mutex> lock(*dbMutex);
+            Vector<string> droppedKeys;
+            size_t dropped = coll->applyRetention(time(nullptr), droppedKeys);
+            for (size_t j = 0; j < droppedKeys.size(); j++) {
+                cout << "[RETENTION] Dropped partition " << droppedKeys[j] << " in database "
+                     << db->getName() << endl;
+            }
+            if (!droppedKeys.empty()) {
+                cout << "[RETENTION] Removed " << dropped << " expired document(s) in database "
+                     << db->getName() << endl;
+            }
+        }
+
+        Vector<PartitionSnapshot> snapshot;
+        {
+            //под мьютексом только копия измененных разделов и смена журнала
+            lock_guard<mutex> lock(*dbMutex);
+            if (!coll->needsCompaction(compactionPolicy)) continue;
+            if (!coll->beginCompaction(snapshot)) {
+                cerr << "[COMPACTOR][ERROR] Failed to rotate log in database " << db->getName() << endl;
+                continue;
+            }
+        }
+
+        auto startTime = chrono::steady_clock::now();
+        bool written = coll->writeSnapshot(snapshot);
+        {
+            lock_guard<mutex> lock(*dbMutex);
+            coll->finishCompaction(snapshot, written);
+        }
+
+        auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime);
+        if (written) {
+            size_t docCount = 0;
+            for (size_t j = 0; j < snapshot.size(); j++) {
+                docCount += snapshot[j].documents.size();
+            }
+            cout << "[COMPACTOR] Wrote " << snapshot.size() << " partition segment(s) with " << docCount
+                 << " document(s) in database " << db->getName() << " (" << elapsed.count() << " ms)" << endl;
+        } else {
+            cerr << "[COMPACTOR][ERROR] Failed to write snapshot in database " << db->getName() << endl;
+        }
+    }
+}
+
+//временная память запроса: разбор JSON и промежуточные контейнеры, освобождается одним разом
+static const size_t REQUEST_ARENA_CHUNK = 64 * 1024;
+
 void ConnectionManager::processRequest(int clientSocket, const string& requestData) {
+    Arena scratch(REQUEST_ARENA_CHUNK);
     try {
-        Request req = Request::fromJson(requestData);
+        Request req = Request::fromJson(requestData, &scratch);
         Response resp;
 
         if (req.operation == "insert") {
             resp = insertDocument(req);
         } else if (req.operation == "find") {
             resp = findDocuments(req);
+        } else if (req.operation == "explain") {
+            resp = explainQuery(req);
         } else if (req.operation == "delete") {
             resp = deleteDocuments(req);
+        } else if (req.operation == "configure") {
+            resp = configureCollection(req);
+        } else if (req.operation == "create_index") {
+            resp = createIndex(req);
+        } else if (req.operation == "export") {
+            resp = exportCollection(req);
+        } else if (req.operation == "import") {
+            resp = importCollection(req);
+        } else if (req.operation == "stats") {
+            resp = collectStats(req);
         } else {
             cerr << "[SERVER][ERROR] Unknown operation: " << req.operation << endl;
             resp.status = "error";
             resp.message = "Unknown operation: " + req.operation;
         }
 
-        string responseJson = resp.toJson();
+        string responseJson = resp.toJson(&scratch);
 
         const char* responseData = responseJson.c_str();
         size_t totalLen = responseJson.length();
@@ -376,6 +596,17 @@ void ConnectionManager::processRequest(int clientSocket, const string& requestDa
 
 Response ConnectionManager::insertDocument(const Request& req) {
     Response resp;
+    DurabilityMode durability;
+    if (!resolveDurability(req, durability, resp.message)) {
+        resp.status = "error";
+        resp.count = 0;
+        return resp;
+    }
+    resp.durability = durabilityModeName(durability);
+
+    //коллекция не выгрузится, пока commit ниже ждет журнал без мьютекса бд
+    shared_lock<shared_timed_mutex> maintenance(maintenanceMutex);
+
     Database* dbValue = nullptr;
     bool found = databases.get(req.database, dbValue);
     mutex* mutexPtr = nullptr;
@@ -410,51 +641,53 @@ Response ConnectionManager::insertDocument(const Request& req) {
         Database* db = nullptr;
         if (!found) {
             db = new Database(req.database);
+            lock_guard<mutex> mapLock(mapMutex);
             databases.put(req.database, db);
         } else {
             db = dbValue;
         }
         Collection& coll = db->getCollection(req.collection);
 
-        int insertedCount = 0;
-        Vector<string> insertedIds;
-
+        //разобранные документы нужны только до построения блоков в insertBatch
+        Vector<HashMap<string, string>> batch(req.scratch);
+        JsonParser parser(req.scratch);
         for (size_t i = 0; i < req.data.size(); i++) {
-            JsonParser parser;
             try {
                 HashMap<string, string> docData = parser.parse(req.data[i]);
                 if (docData.size() == 0 && req.data[i] != "{}") {
                     cerr << "[SERVER][WARN] Invalid JSON document: " << req.data[i] << endl;
                     continue;
                 }
-
-                string result = coll.insert(req.data[i]);
-
-                if (result.find("successfully") != string::npos) {
-                    insertedCount++;
-                    size_t pos = result.find("doc_");
-                    if (pos != string::npos) {
-                        size_t end = result.find(" ", pos);
-                        if (end != string::npos) {
-                            string id = result.substr(pos, end - pos);
-                            insertedIds.push_back(id);
-                        }
-                    }
-                }
+                batch.push_back(std::move(docData));
             } catch (const exception& e) {
                 cerr << "[SERVER][ERROR] Failed to parse document: " << e.what() << endl;
                 continue;
             }
         }
 
-        resp.status = "success";
-        resp.message = "Inserted " + to_string(insertedCount) + " document(s)";
-        resp.count = insertedCount;
-        for (size_t i = 0; i < insertedIds.size(); i++) {
-            resp.data.push_back("{\"id\":\"" + insertedIds[i] + "\"}");
-        }
+        Vector<string> insertedIds;
+        uint64_t sequence = coll.insertBatch(batch, insertedIds, durability);
         mutexPtr->unlock();
 
+        //запись на диск уже без мьютекса бд: пачки других соединений уходят одним write
+        if (coll.commit(sequence, durability)) {
+            resp.status = "success";
+            resp.message = "Inserted " + to_string(insertedIds.size()) + " document(s)";
+            resp.count = insertedIds.size();
+            for (size_t i = 0; i < insertedIds.size(); i++) {
+                resp.data.push_back("{\"id\":\"" + insertedIds[i] + "\"}");
+            }
+        } else {
+            //пачки нет в журнале: документы не должны остаться видимыми до рестарта
+            {
+                lock_guard<mutex> lock(*mutexPtr);
+                coll.discardInserted(insertedIds);
+            }
+            resp.status = "error";
+            resp.message = "Failed to write " + to_string(insertedIds.size()) + " document(s) to disk";
+            resp.count = 0;
+        }
+
     } else {
         cerr << "[SERVER][ERROR] Database lock timeout for: " << req.database << endl;
         resp.status = "error";
@@ -494,10 +727,9 @@ Response ConnectionManager::findDocuments(const Request& req) {
     ConditionParser parser;
     QueryCondition condition = parser.parse(req.query);
 
-    size_t total_count = coll.count(condition);
-
-    //с пагинацией
-    Vector<Document> results = coll.find(condition, req.page, req.limit);
+    //один проход: общее число совпадений и только документы страницы
+    size_t total_count = 0;
+    Vector<Document> results = coll.find(condition, req.page, req.limit, &total_count);
 
     resp.status = "success";
     resp.message = "Found " + to_string(results.size()) + " document(s)";
@@ -518,8 +750,79 @@ Response ConnectionManager::findDocuments(const Request& req) {
     return resp;
 }
 
+static string formatMs(double ms) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", ms);
+    return buffer;
+}
+
+//запрос find выполняется без выдачи документов: data[0] - итог и порядок проверок условия,
+//дальше по записи на раздел с планом, оценкой и фактом
+Response ConnectionManager::explainQuery(const Request& req) {
+    Response resp;
+    Database* db = nullptr;
+    mutex* mutexPtr = lockDatabase(req.database, false, db, resp.message);
+    if (!mutexPtr) {
+        resp.status = "error";
+        return resp;
+    }
+
+    Collection& coll = db->getCollection(req.collection);
+    ConditionParser parser;
+    QueryCondition condition = parser.parse(req.query);
+    string filter;
+    Vector<PartitionExplain> partitions = coll.explain(condition, filter);
+    size_t partitionTotal = coll.partitionCount();
+    mutexPtr->unlock();
+
+    size_t estimated = 0, examined = 0, matched = 0;
+    double planMs = 0, executeMs = 0;
+    for (size_t i = 0; i < partitions.size(); i++) {
+        const PartitionExplain& entry = partitions[i];
+        estimated += entry.estimatedRows;
+        examined += entry.examinedRows;
+        matched += entry.matchedRows;
+        planMs += entry.planMs;
+        executeMs += entry.executeMs;
+    }
+    resp.data.push_back("{\"filter\":\"" + escapeJsonString(filter) +
+                        "\",\"partitions_scanned\":\"" + to_string(partitions.size()) +
+                        "\",\"partitions_pruned\":\"" + to_string(partitionTotal - partitions.size()) +
+                        "\",\"estimated_rows\":\"" + to_string(estimated) +
+                        "\",\"examined_rows\":\"" + to_string(examined) +
+                        "\",\"matched_rows\":\"" + to_string(matched) +
+                        "\",\"plan_ms\":\"" + formatMs(planMs) +
+                        "\",\"execute_ms\":\"" + formatMs(executeMs) + "\"}");
+    for (size_t i = 0; i < partitions.size(); i++) {
+        const PartitionExplain& entry = partitions[i];
+        resp.data.push_back("{\"partition\":\"" + escapeJsonString(entry.key) +
+                            "\",\"plan\":\"" + escapeJsonString(entry.plan) +
+                            "\",\"documents\":\"" + to_string(entry.documents) +
+                            "\",\"estimated_rows\":\"" + to_string(entry.estimatedRows) +
+                            "\",\"examined_rows\":\"" + to_string(entry.examinedRows) +
+                            "\",\"matched_rows\":\"" + to_string(entry.matchedRows) +
+                            "\",\"plan_ms\":\"" + formatMs(entry.planMs) +
+                            "\",\"execute_ms\":\"" + formatMs(entry.executeMs) + "\"}");
+    }
+
+    resp.status = "success";
+    resp.count = matched;
+    resp.message = "Matched " + to_string(matched) + " document(s) in " + to_string(partitions.size()) +
+                   " partition(s): estimated " + to_string(estimated) + ", examined " + to_string(examined) +
+                   " (plan " + formatMs(planMs) + " ms, execution " + formatMs(executeMs) + " ms)";
+    return resp;
+}
+
 Response ConnectionManager::deleteDocuments(const Request& req) {
     Response resp;
+    DurabilityMode durability;
+    if (!resolveDurability(req, durability, resp.message)) {
+        resp.status = "error";
+        resp.count = 0;
+        return resp;
+    }
+    resp.durability = durabilityModeName(durability);
+
     mutex* mutexPtr = nullptr;
     bool mutexFound = dbMutexes.get(req.database, mutexPtr);
 
@@ -560,7 +863,7 @@ Response ConnectionManager::deleteDocuments(const Request& req) {
         ConditionParser parser;
         QueryCondition condition = parser.parse(req.query);
 
-        string result = coll.remove(condition);
+        string result = coll.remove(condition, durability);
 
         if (result.find("successfully") != string::npos) {
             resp.status = "success";
@@ -602,4 +905,271 @@ Response ConnectionManager::deleteDocuments(const Request& req) {
         resp.count = 0;
     }
     return resp;
-}
\ No newline at end of file
+}
+
+//захват мьютекса бд с таймаутом, при create база создается
+mutex* ConnectionManager::lockDatabase(const string& dbName, bool create, Database*& db, string& error) {
+    mutex* mutexPtr = nullptr;
+    {
+        lock_guard<mutex> lock(mapMutex);
+        if (!dbMutexes.get(dbName, mutexPtr)) {
+            if (!create) {
+                error = "Database not found: " + dbName;
+                return nullptr;
+            }
+            mutexPtr = new mutex();
+            dbMutexes.put(dbName, mutexPtr);
+        }
+    }
+
+    bool lockAcquired = false;
+    auto startTime = chrono::steady_clock::now();
+    while (chrono::steady_clock::now() - startTime < chrono::seconds(3)) {
+        if (mutexPtr->try_lock()) {
+            lockAcquired = true;
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    if (!lockAcquired) {
+        error = "Database lock timeout for: " + dbName;
+        return nullptr;
+    }
+
+    lock_guard<mutex> lock(mapMutex);
+    if (!databases.get(dbName, db)) {
+        if (!create) {
+            mutexPtr->unlock();
+            error = "Database not found: " + dbName;
+            return nullptr;
+        }
+        db = new Database(dbName);
+        databases.put(dbName, db);
+    }
+    return mutexPtr;
+}
+
+Response ConnectionManager::exportCollection(const Request& req) {
+    Response resp;
+    Database* db = nullptr;
+    mutex* mutexPtr = lockDatabase(req.database, false, db, resp.message);
+    if (!mutexPtr) {
+        resp.status = "error";
+        return resp;
+    }
+
+    Collection& coll = db->getCollection(req.collection);
+    string filename = req.database + "/" + req.collection + ".export.json";
+    if (coll.exportJson(filename)) {
+        resp.status = "success";
+        resp.message = "Exported " + to_string(coll.size()) + " document(s) to " + filename;
+        resp.count = coll.size();
+    } else {
+        resp.status = "error";
+        resp.message = "Failed to write " + filename;
+    }
+    mutexPtr->unlock();
+    return resp;
+}
+
+Response ConnectionManager::importCollection(const Request& req) {
+    Response resp;
+    DurabilityMode durability;
+    if (!resolveDurability(req, durability, resp.message)) {
+        resp.status = "error";
+        return resp;
+    }
+    resp.durability = durabilityModeName(durability);
+
+    Database* db = nullptr;
+    mutex* mutexPtr = lockDatabase(req.database, true, db, resp.message);
+    if (!mutexPtr) {
+        resp.status = "error";
+        return resp;
+    }
+
+    Collection& coll = db->getCollection(req.collection);
+    string filename = req.database + "/" + req.collection + ".export.json";
+    size_t before = coll.size();
+    string result = coll.importJson(filename, durability);
+    resp.status = result.find("successfully") != string::npos ? "success" : "error";
+    resp.message = result;
+    resp.count = coll.size() - before;
+    mutexPtr->unlock();
+    return resp;
+}
+
+Response ConnectionManager::configureCollection(const Request& req) {
+    Response resp;
+    Database* db = nullptr;
+    mutex* mutexPtr = lockDatabase(req.database, true, db, resp.message);
+    if (!mutexPtr) {
+        resp.status = "error";
+        return resp;
+    }
+
+    Collection& coll = db->getCollection(req.collection);
+    CollectionOptions options = coll.getOptions();//заданные ключи меняются, остальные остаются
+    if (req.data.size() > 0) {
+        JsonParser parser(req.scratch);
+        if (!CollectionOptions::fromMap(parser.parse(req.data[0]), options, resp.message)) {
+            resp.status = "error";
+            mutexPtr->unlock();
+            return resp;
+        }
+    }
+
+    if (coll.setOptions(options)) {
+        resp.status = "success";
+        resp.message = "Collection " + req.collection + " configured: " + options.toJson();
+        resp.count = coll.partitionCount();
+        resp.data.push_back(options.toJson());
+    } else {
+        resp.status = "error";
+        resp.message = "Failed to save options for collection " + req.collection;
+    }
+    mutexPtr->unlock();
+    return resp;
+}
+
+//data[0]: {"field":"hostname","type":"hash"}, тип по умолчанию hash
+//упорядоченный индекс без поля строится по timestamp
+Response ConnectionManager::createIndex(const Request& req) {
+    Response resp;
+    IndexSpec spec;
+    if (req.data.size() > 0) {
+        JsonParser parser(req.scratch);
+        HashMap<string, string> params = parser.parse(req.data[0]);
+        params.get("field", spec.field);
+        string type;
+        if (params.get("type", type) && !parseIndexType(type, spec.type)) {
+            resp.status = "error";
+            resp.message = "Unknown index type: " + type;
+            return resp;
+        }
+    }
+    if (spec.field.empty() && spec.type == IndexType::ORDERED) {
+        spec.field = "timestamp";
+    }
+
+    Database* db = nullptr;
+    mutex* mutexPtr = lockDatabase(req.database, true, db, resp.message);
+    if (!mutexPtr) {
+        resp.status = "error";
+        return resp;
+    }
+
+    Collection& coll = db->getCollection(req.collection);
+    auto startTime = chrono::steady_clock::now();
+    if (coll.createIndex(spec, resp.message)) {
+        auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime);
+        resp.status = "success";
+        resp.message = "Created " + indexTypeName(spec.type) + " index on " + spec.field + " in collection " +
+                       req.collection + " (" + to_string(coll.size()) + " document(s), " +
+                       to_string(elapsed.count()) + " ms)";
+        resp.count = coll.getOptions().indexes.size();
+        resp.data.push_back(coll.getOptions().toJson());
+    } else {
+        resp.status = "error";
+    }
+    mutexPtr->unlock();
+    return resp;
+}
+
+//сверх предела выгружаются коллекции, к которым дольше всего не обращались;
+//тронутые за последний интервал проверки считаются рабочими и остаются в памяти
+void ConnectionManager::enforceMemoryLimit() {
+    if (memoryLimit == 0) {
+        return;
+    }
+
+    struct Candidate {
+        Database* db;
+        mutex* dbMutex;
+        string name;
+        size_t bytes;
+        int64_t lastAccessMs;
+    };
+    Vector<Candidate> candidates;
+    size_t total = 0;
+    Vector<pair<Database*, mutex*>> targets = getOpenDatabases();
+    for (size_t i = 0; i < targets.size(); i++) {
+        Vector<CollectionUsage> usage;
+        {
+            lock_guard<mutex> lock(*targets[i].second);
+            usage = targets[i].first->memoryUsage();
+        }
+        for (size_t j = 0; j < usage.size(); j++) {
+            total += usage[j].memory.total();
+            candidates.push_back({targets[i].first, targets[i].second, usage[j].name,
+                                  usage[j].memory.total(), usage[j].lastAccessMs});
+        }
+    }
+    if (total <= memoryLimit) {
+        return;
+    }
+
+    if (candidates.size() > 1) {
+        std::sort(&candidates[0], &candidates[0] + candidates.size(), [](const Candidate& a, const Candidate& b) {
+            return a.lastAccessMs < b.lastAccessMs;
+        });
+    }
+    int64_t now = chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t hotMs = (int64_t)compactionPolicy.checkIntervalSec * 1000;
+
+    unique_lock<shared_timed_mutex> maintenance(maintenanceMutex);
+    for (size_t i = 0; i < candidates.size() && total > memoryLimit; i++) {
+        const Candidate& candidate = candidates[i];
+        if (now - candidate.lastAccessMs < hotMs) {
+            break;//дальше только более свежие
+        }
+        lock_guard<mutex> lock(*candidate.dbMutex);
+        if (candidate.db->evict(candidate.name)) {
+            total -= candidate.bytes;
+            cout << "[MEMORY] Evicted collection " << candidate.name << " from database "
+                 << candidate.db->getName() << " (" << candidate.bytes / 1024 << " KB)" << endl;
+        }
+    }
+    if (total > memoryLimit) {
+        cout << "[MEMORY] " << total / 1024 << " KB in use, over the limit of "
+             << memoryLimit / 1024 << " KB: remaining collections are in active use" << endl;
+    }
+}
+
+//память загруженных коллекций: всех баз или одной, можно сузить до коллекции
+Response ConnectionManager::collectStats(const Request& req) {
+    Response resp;
+    size_t totalBytes = 0;
+    size_t collectionCount = 0;
+    Vector<pair<Database*, mutex*>> targets = getOpenDatabases();
+    for (size_t i = 0; i < targets.size(); i++) {
+        Database* db = targets[i].first;
+        if (!req.database.empty() && db->getName() != req.database) continue;
+        Vector<CollectionUsage> usage;
+        {
+            lock_guard<mutex> lock(*targets[i].second);
+            usage = db->memoryUsage();
+        }
+        for (size_t j = 0; j < usage.size(); j++) {
+            const CollectionUsage& collection = usage[j];
+            if (!req.collection.empty() && collection.name != req.collection) continue;
+            totalBytes += collection.memory.total();
+            collectionCount++;
+            resp.data.push_back("{\"database\":\"" + db->getName() +
+                                "\",\"collection\":\"" + collection.name +
+                                "\",\"documents\":\"" + to_string(collection.documents) +
+                                "\",\"memory_bytes\":\"" + to_string(collection.memory.total()) +
+                                "\",\"document_bytes\":\"" + to_string(collection.memory.documentBytes) +
+                                "\",\"wasted_bytes\":\"" + to_string(collection.memory.wastedBytes) +
+                                "\",\"index_bytes\":\"" + to_string(collection.memory.indexBytes) +
+                                "\",\"mapped_bytes\":\"" + to_string(collection.memory.mappedBytes) + "\"}");
+        }
+    }
+
+    resp.status = "success";
+    resp.count = collectionCount;
+    resp.message = to_string(totalBytes) + " bytes in " + to_string(collectionCount) + " loaded collection(s), limit " +
+                   (memoryLimit > 0 ? to_string(memoryLimit) + " bytes" : string("none"));
+    return resp;
+}
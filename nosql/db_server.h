@@ -6,6 +6,7 @@
 #include "HashMap.h"
 #include "vector.h"
 #include <mutex>
+#include <shared_mutex>
 #include <condition_variable>
 #include <queue>
 #include <thread>
@@ -25,15 +26,48 @@ private:
     condition_variable queueCV;
     
     Vector<thread> workerThreads; 
+
+    CompactionPolicy compactionPolicy;
+    thread compactorThread;
+    mutex compactorMutex;
+    condition_variable compactorCV;
+
+    DurabilityMode defaultDurability;
+    HashMap<string, DurabilityMode> databaseDurability;
+    int flushIntervalMs;
+    thread flusherThread;
+
+    size_t loadThreads;//0 - коллекции грузятся при первом запросе
+
+    size_t memoryLimit;//байты, 0 - без предела
+    //выгрузка коллекции (исключительно) не идет одновременно со сбросом журналов и с фиксацией
+    //вставок, которые пишут журнал уже без мьютекса бд (совместно); берется раньше мьютекса бд
+    shared_timed_mutex maintenanceMutex;
     
     bool isValidJsonRequest(const string& jsonStr);
     
     void workerThread();
+    void compactionLoop();
+    void compactDatabase(Database* db, mutex* dbMutex);
+    void flushLoop();
+    void flushAll();
+    void preloadDatabases();
+    void enforceMemoryLimit();
+    Vector<pair<Database*, mutex*>> getOpenDatabases();
+    bool resolveDurability(const Request& req, DurabilityMode& mode, string& error);
     void processRequest(int clientSocket, const string& requestData);
     
     Response insertDocument(const Request& req);
     Response findDocuments(const Request& req);
+    Response explainQuery(const Request& req);
     Response deleteDocuments(const Request& req);
+    Response configureCollection(const Request& req);
+    Response createIndex(const Request& req);
+    Response exportCollection(const Request& req);
+    Response importCollection(const Request& req);
+    Response collectStats(const Request& req);
+
+    mutex* lockDatabase(const string& dbName, bool create, Database*& db, string& error);
     
 public:
     ConnectionManager();
@@ -41,6 +75,12 @@ public:
     
     bool start(int port, int numWorkers = 4);
     void stop();
+    void setCompactionPolicy(const CompactionPolicy& policy) { compactionPolicy = policy; }
+    void setDefaultDurability(DurabilityMode mode) { defaultDurability = mode; }
+    void setDatabaseDurability(const string& dbName, DurabilityMode mode) { databaseDurability.put(dbName, mode); }
+    void setFlushInterval(int ms) { flushIntervalMs = ms; }
+    void setPreload(size_t threads) { loadThreads = threads; }
+    void setMemoryLimit(size_t bytes) { memoryLimit = bytes; }
 };
 
 #endif
\ No newline at end of file
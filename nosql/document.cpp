@@ -1,62 +1,327 @@
 #include "document.h"
-#include "JsonParser.h"
+#include "binary_io.h"
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <new>
 
-Document::Document() {
-    static int counter = 0;
-    id = "doc_" + to_string(counter++);
+namespace {
+struct FieldValue {
+    uint32_t fieldId;
+    const char* data;
+    size_t length;
+    uint32_t code;//NO_CODE - значение хранится в блоке
+};
 }
 
-Document::Document(const string& jsonStr) {
-    static int counter = 0;
-    id = "doc_" + to_string(counter++);
-    JsonParser parser;
-    data = parser.parse(jsonStr);
+static const uint32_t ENCODED_VALUE = 0xFFFFFFFFu;//длина слота: в offset код из словаря
+
+//счетчик ссылок лежит прямо перед своим блоком, 8 байт ради выравнивания блока
+static const size_t REFCOUNT_SIZE = 8;
+
+static atomic<uint32_t>* refCount(char* block) {
+    return (atomic<uint32_t>*)(block - REFCOUNT_SIZE);
 }
 
-Document::Document(const HashMap<string, string>& dataMap, const string& docId) {
-    if (docId.empty()) {
-        static int counter = 0;
-        id = "doc_" + to_string(counter++);
-    } else {
-        id = docId;
+static char* allocateShared(size_t size) {
+    char* raw = new char[REFCOUNT_SIZE + size];
+    new (raw) atomic<uint32_t>(1);
+    return raw + REFCOUNT_SIZE;
+}
+
+static void retain(char* block) {
+    refCount(block)->fetch_add(1, memory_order_relaxed);
+}
+
+//собирает блок документа, поля упорядочены по номеру
+static char* buildBlock(const string& id, Vector<FieldValue>& values) {
+    if (values.size() > 1) {
+        std::sort(&values[0], &values[0] + values.size(), [](const FieldValue& a, const FieldValue& b) {
+            return a.fieldId < b.fieldId;
+        });
+    }
+    size_t size = 12 + values.size() * 12 + id.size();
+    for (size_t i = 0; i < values.size(); i++) {
+        if (values[i].code == FieldDictionary::NO_CODE) {
+            size += values[i].length;
+        }
+    }
+
+    char* block = allocateShared(size);
+    uint32_t* header = (uint32_t*)block;
+    header[0] = (uint32_t)size;
+    header[1] = (uint32_t)values.size();
+    header[2] = (uint32_t)id.size();
+    uint32_t* slot = header + 3;
+    size_t offset = 12 + values.size() * 12;
+    memcpy(block + offset, id.data(), id.size());
+    offset += id.size();
+    for (size_t i = 0; i < values.size(); i++) {
+        slot[0] = values[i].fieldId;
+        if (values[i].code != FieldDictionary::NO_CODE) {
+            slot[1] = values[i].code;//закодированное значение места в блоке не занимает
+            slot[2] = ENCODED_VALUE;
+        } else {
+            slot[1] = (uint32_t)offset;
+            slot[2] = (uint32_t)values[i].length;
+            memcpy(block + offset, values[i].data, values[i].length);
+            offset += values[i].length;
+        }
+        slot += 3;
     }
-    data = dataMap;
+    return block;
 }
 
-string Document::getId() const {
-    return id;
+Document::Document() : fields(nullptr), block(nullptr), owned(false) {
+}
+
+Document::Document(const HashMap<string, string>& dataMap, const string& docId, FieldDictionary& dictionary)
+    : fields(&dictionary), block(nullptr), owned(true) {
+    Vector<FieldValue> values;
+    for (const auto& entry : dataMap) {
+        if (entry.key == "_id") continue;//id хранится в заголовке
+        uint32_t fieldId = dictionary.intern(entry.key);
+        if (fieldId == FieldDictionary::NOT_FOUND) continue;
+        const string& value = entry.value;
+        uint32_t code = dictionary.encode(fieldId, value.data(), value.size());
+        values.push_back(FieldValue{fieldId, value.data(), value.size(), code});
+    }
+    block = buildBlock(docId, values);
+}
+
+Document::~Document() {
+    release();
+}
+
+void Document::release() {
+    if (owned && block && refCount(block)->fetch_sub(1, memory_order_acq_rel) == 1) {
+        delete[] (block - REFCOUNT_SIZE);
+    }
+    block = nullptr;
+    owned = false;
+}
+
+//блок общий: копия только увеличивает счетчик
+Document::Document(const Document& other) : fields(other.fields), block(other.block), owned(other.owned) {
+    if (owned && block) {
+        retain(block);
+    }
+}
+
+Document& Document::operator=(const Document& other) {
+    if (this != &other) {
+        Document copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+Document::Document(Document&& other) noexcept : fields(other.fields), block(other.block), owned(other.owned) {
+    other.block = nullptr;
+    other.owned = false;
+}
+
+Document& Document::operator=(Document&& other) noexcept {
+    if (this != &other) {
+        release();
+        fields = other.fields;
+        block = other.block;
+        owned = other.owned;
+        other.block = nullptr;
+        other.owned = false;
+    }
+    return *this;
+}
+
+size_t Document::byteSize() const {
+    return block ? ((const uint32_t*)block)[0] : 0;
+}
+
+uint32_t Document::fieldCount() const {
+    return block ? ((const uint32_t*)block)[1] : 0;
+}
+
+const Document::Slot* Document::slots() const {
+    return (const Slot*)(block + HEADER_SIZE);
+}
+
+Document Document::copyTo(Arena& arena) const {
+    Document copy;
+    copy.fields = fields;
+    if (block) {
+        size_t size = byteSize();
+        copy.block = (char*)arena.allocate(size, 4);
+        memcpy(copy.block, block, size);
+    }
+    return copy;
+}
+
+uint32_t Document::slotValue(const Slot& slot, const char*& value, size_t& length) const {
+    if (slot.length == ENCODED_VALUE) {
+        const string& decoded = fields->value(slot.fieldId, slot.offset);
+        value = decoded.data();
+        length = decoded.size();
+        return slot.offset;
+    }
+    value = block + slot.offset;
+    length = slot.length;
+    return FieldDictionary::NO_CODE;
+}
+
+bool Document::findValue(uint32_t fieldId, const char*& value, size_t& length, uint32_t& code) const {
+    if (!block) return false;
+    if (fieldId == FieldDictionary::ID_FIELD) {
+        length = ((const uint32_t*)block)[2];
+        value = block + HEADER_SIZE + fieldCount() * sizeof(Slot);
+        code = FieldDictionary::NO_CODE;
+        return true;
+    }
+    const Slot* slot = slots();
+    uint32_t count = fieldCount();
+    for (uint32_t i = 0; i < count && slot[i].fieldId <= fieldId; i++) {//слоты по возрастанию номера
+        if (slot[i].fieldId == fieldId) {
+            code = slotValue(slot[i], value, length);
+            return true;
+        }
+    }
+    return false;
 }
 
-void Document::setData(const HashMap<string, string>& newData) {
-    data = newData;
+string Document::getId() const {
+    const char* value;
+    size_t length;
+    uint32_t code;
+    if (!findValue(FieldDictionary::ID_FIELD, value, length, code)) return "";
+    return string(value, length);
 }
 
 HashMap<string, string> Document::getData() const {
+    HashMap<string, string> data;
+    if (!block) return data;
+    data.put("_id", getId());
+    const Slot* slot = slots();
+    for (uint32_t i = 0; i < fieldCount(); i++) {
+        const char* value;
+        size_t length;
+        slotValue(slot[i], value, length);
+        data.put(fields->name(slot[i].fieldId), string(value, length));
+    }
     return data;
 }
 
+bool Document::getField(const string& field, string& value) const {
+    if (!fields) return false;
+    return getFieldById(fields->find(field), value);
+}
+
+bool Document::getFieldById(uint32_t fieldId, string& value) const {
+    const char* data;
+    size_t length;
+    uint32_t code;
+    if (fieldId == FieldDictionary::NOT_FOUND || !findValue(fieldId, data, length, code)) {
+        return false;
+    }
+    value.assign(data, length);
+    return true;
+}
+
 string Document::to_json() const {
-    string json = "{";
-    auto items = data.items();
-    bool first = true;
-
-    if (!first) json += ",";//1-id
-    json += "\"_id\":\"" + id + "\"";
-    first = false;
-
-    for (size_t i = 0; i < items.size(); i++) {//остальные поля
-        if (items[i].first != "_id") {
-            if (!first) {
-                json += ",";
-            }
-            json += "\"" + items[i].first + "\":\"" + items[i].second + "\"";
-            first = false;
-        }
+    string json = "{\"_id\":\"" + getId() + "\"";
+    const Slot* slot = slots();
+    for (uint32_t i = 0; i < fieldCount(); i++) {
+        const char* value;
+        size_t length;
+        slotValue(slot[i], value, length);
+        json += ",\"" + fields->name(slot[i].fieldId) + "\":\"";
+        json.append(value, length);
+        json += "\"";
     }
     json += "}";
     return json;
 }
 
+//формат: id, число полей, пары ключ/значение с префиксом длины (_id тоже среди полей)
+string Document::serialize() const {
+    string out;
+    string id = getId();
+    appendString(out, id);
+    appendUint32(out, fieldCount() + 1);
+    appendString(out, "_id");
+    appendString(out, id);
+    const Slot* slot = slots();
+    for (uint32_t i = 0; i < fieldCount(); i++) {
+        const char* value;
+        size_t length;
+        slotValue(slot[i], value, length);
+        appendString(out, fields->name(slot[i].fieldId));
+        appendUint32(out, (uint32_t)length);
+        out.append(value, length);
+    }
+    return out;
+}
+
+bool Document::deserialize(const char* bytes, size_t len, Document& out, FieldDictionary& dictionary) {
+    size_t pos = 0;
+    string docId;
+    if (!readString(bytes, len, pos, docId)) return false;
+    if (pos + 4 > len) return false;
+    uint32_t fieldCount = readUint32(bytes + pos);
+    pos += 4;
+
+    //значения не копируются, блок собирается прямо из буфера
+    Vector<FieldValue> values;
+    for (uint32_t i = 0; i < fieldCount; i++) {
+        string key;
+        if (!readString(bytes, len, pos, key)) return false;
+        if (pos + 4 > len) return false;
+        uint32_t valueLength = readUint32(bytes + pos);
+        pos += 4;
+        if (pos + valueLength > len) return false;
+        if (key != "_id") {
+            uint32_t fieldId = dictionary.intern(key);
+            if (fieldId != FieldDictionary::NOT_FOUND) {
+                uint32_t code = dictionary.encode(fieldId, bytes + pos, valueLength);
+                values.push_back(FieldValue{fieldId, bytes + pos, valueLength, code});
+            }
+        }
+        pos += valueLength;
+    }
+    Document doc;
+    doc.fields = &dictionary;
+    doc.block = buildBlock(docId, values);
+    doc.owned = true;
+    out = std::move(doc);
+    return true;
+}
+
+bool Document::view(const char* data, size_t len, FieldDictionary& dictionary, Document& out) {
+    //блок читается кастами к uint32_t, поэтому выравнивание тоже часть разметки
+    if (len < HEADER_SIZE || ((uintptr_t)data & 3) != 0) return false;
+    const uint32_t* header = (const uint32_t*)data;
+    uint64_t count = header[1];
+    uint64_t valuesStart = HEADER_SIZE + count * sizeof(Slot) + header[2];
+    if (header[0] != len || valuesStart > len) return false;
+    const Slot* slot = (const Slot*)(data + HEADER_SIZE);
+    uint32_t knownFields = dictionary.size();
+    for (uint64_t i = 0; i < count; i++) {
+        //findValue идет по слотам по возрастанию номера и останавливается на большем
+        if (slot[i].fieldId == FieldDictionary::ID_FIELD || slot[i].fieldId >= knownFields ||
+            (i > 0 && slot[i].fieldId <= slot[i - 1].fieldId)) {
+            return false;
+        }
+        if (slot[i].length == ENCODED_VALUE) {
+            if (slot[i].offset >= dictionary.codeCount(slot[i].fieldId)) return false;
+        } else if (slot[i].offset < valuesStart || (uint64_t)slot[i].offset + slot[i].length > len) {
+            return false;
+        }
+    }
+    Document doc;
+    doc.fields = &dictionary;
+    doc.block = const_cast<char*>(data);//вид не пишет в блок и не освобождает его
+    out = std::move(doc);
+    return true;
+}
+
 bool Document::likeMatch(const string& value, const string& pattern) const {
     const char* valueStr = value.c_str();
     const char* patternStr = pattern.c_str();
@@ -97,15 +362,30 @@ bool Document::likeMatch(const string& value, const string& pattern) const {
 }
 
 
-bool Document::compareTimestamps(const string& actual, const string& expected, bool greaterThan) const {
-    string expectedFull = expected;
+string Document::timestampBound(const string& expected, bool greaterThan) {
     if (expected.length() == 10 && expected.find('T') == string::npos) { 
         if (greaterThan) {
-            expectedFull = expected + "T00:00:00"; 
+            return expected + "T00:00:00"; 
         } else {
-            expectedFull = expected + "T23:59:59"; 
+            return expected + "T23:59:59"; 
         }
     }
+    return expected;
+}
+
+bool Document::parseNumber(const string& str, double& out) {
+    if (str.empty()) return false;
+    try {
+        size_t used = 0;
+        out = stod(str, &used);
+        return used == str.length();//"2026-10-16" не число, хотя stod разберет 2026
+    } catch (...) {
+        return false;
+    }
+}
+
+bool Document::compareTimestamps(const string& actual, const string& expected, bool greaterThan) const {
+    string expectedFull = timestampBound(expected, greaterThan);
 
     if (greaterThan) {
         return actual > expectedFull;
@@ -115,33 +395,28 @@ bool Document::compareTimestamps(const string& actual, const string& expected, b
 }
 
 bool Document::compareValues(const string& actual, const string& expected, ConditionType op, const string& field_name) const {
+    double a = 0, b = 0;
     switch (op) {
         case ConditionType::EQUAL://равенство строк
             return actual == expected;
 
         case ConditionType::GREATER_THAN://больше
-            try {
-                double a = stod(actual);
-                double b = stod(expected);
+            if (parseNumber(actual, a) && parseNumber(expected, b)) {
                 return a > b;
-            } catch (...) {
-                if (field_name == "timestamp") {
-                    return compareTimestamps(actual, expected, true); 
-                }
-                return actual > expected;
             }
+            if (field_name == "timestamp") {
+                return compareTimestamps(actual, expected, true); 
+            }
+            return actual > expected;
 
         case ConditionType::LESS_THAN://меньше
-            try {
-                double a = stod(actual);
-                double b = stod(expected);
+            if (parseNumber(actual, a) && parseNumber(expected, b)) {
                 return a < b;
-            } catch (...) {
-                if (field_name == "timestamp") {
-                    return compareTimestamps(actual, expected, false);
-                }
-                return actual < expected;
             }
+            if (field_name == "timestamp") {
+                return compareTimestamps(actual, expected, false);
+            }
+            return actual < expected;
 
         case ConditionType::LIKE:
             return likeMatch(actual, expected);
@@ -151,26 +426,60 @@ bool Document::compareValues(const string& actual, const string& expected, Condi
     }
 }
 
-bool Document::evaluateCondition(const QueryCondition& condition, const HashMap<string, string>& docData) const {
+//значение поля условия: по номеру, если условие привязано к словарю, иначе по имени
+bool Document::conditionValue(const QueryCondition& condition, const char*& value, size_t& length,
+                              uint32_t& code) const {
+    uint32_t fieldId = condition.fieldId;
+    if (fieldId == QueryCondition::UNBOUND) {
+        if (!fields) return false;
+        fieldId = fields->find(condition.field);
+    }
+    if (fieldId == FieldDictionary::NOT_FOUND) {
+        return false;
+    }
+    return findValue(fieldId, value, length, code);
+}
+
+bool Document::evaluateCondition(const QueryCondition& condition) const {
     switch (condition.type) {
         case ConditionType::EQUAL:
         case ConditionType::GREATER_THAN:
         case ConditionType::LESS_THAN:
         case ConditionType::LIKE: {
-            string actualValue;
-            if (!docData.get(condition.field, actualValue)) {
+            const char* actual;
+            size_t length;
+            uint32_t code;
+            if (!conditionValue(condition, actual, length, code)) {
                 return false;
             }
-            return compareValues(actualValue, condition.value, condition.type, condition.field);
+            if (condition.type == ConditionType::EQUAL && code != FieldDictionary::NO_CODE &&
+                condition.valueCode != QueryCondition::UNBOUND) {
+                return code == condition.valueCode;//оба значения из словаря поля
+            }
+            if (condition.type == ConditionType::EQUAL) {//без копии значения
+                return length == condition.value.size() && memcmp(actual, condition.value.data(), length) == 0;
+            }
+            return compareValues(string(actual, length), condition.value, condition.type, condition.field);
         }
 
         case ConditionType::IN: {
-            string actualValue;
-            if (!docData.get(condition.field, actualValue)) {
+            const char* actual;
+            size_t length;
+            uint32_t code;
+            if (!conditionValue(condition, actual, length, code)) {
+                return false;
+            }
+            if (code != FieldDictionary::NO_CODE && condition.inCodes.size() == condition.inValues.size()) {
+                for (size_t i = 0; i < condition.inCodes.size(); i++) {
+                    if (condition.inCodes[i] == code) {
+                        return true;
+                    }
+                }
                 return false;
             }
             for (size_t i = 0; i < condition.inValues.size(); i++) {
-                if (actualValue == condition.inValues[i]) {
+                const string& expected = condition.inValues[i];
+                if (length == expected.size() && memcmp(actual, expected.data(), length) == 0) {
                     return true;//совпало
                 }
             }
@@ -179,7 +488,7 @@ bool Document::evaluateCondition(const QueryCondition& condition, const HashMap<
 
         case ConditionType::AND: {
             for (size_t i = 0; i < condition.subConditions.size(); i++) {
-                if (!evaluateCondition(condition.subConditions[i], docData)) {
+                if (!evaluateCondition(condition.subConditions[i])) {
                     return false;
                 }
             }
@@ -188,7 +497,7 @@ bool Document::evaluateCondition(const QueryCondition& condition, const HashMap<
 
         case ConditionType::OR: {
             for (size_t i = 0; i < condition.subConditions.size(); i++) {
-                if (evaluateCondition(condition.subConditions[i], docData)) {
+                if (evaluateCondition(condition.subConditions[i])) {
                     return true;
                 }
             }
@@ -201,5 +510,5 @@ bool Document::evaluateCondition(const QueryCondition& condition, const HashMap<
 }
 
 bool Document::matchesCondition(const QueryCondition& condition) const {
-    return evaluateCondition(condition, data);
+    return evaluateCondition(condition);
 }
\ No newline at end of file
@@ -3,34 +3,78 @@
 
 #include "HashMap.h"
 #include "QueryCondition.h"
+#include "field_dictionary.h"
+#include "arena.h"
 #include <string>
 #include <ctime>
 #include <cstdlib>
+#include <cstdint>
 using namespace std;
 
+//документ - один непрерывный блок:
+//[size:4][fieldCount:4][idLength:4] слоты fieldCount*[fieldId:4][offset:4][length:4], затем id и значения
+//имена полей лежат в словаре коллекции, в блоке только их номера
+//значение поля с малым числом различных значений - код из словаря (length = 0xFFFFFFFF, offset = код)
+//блок после сборки не меняется, поэтому копии документа его только делят:
+//свой блок (куча) со счетчиком ссылок перед ним, блок в арене коллекции или в отображенном
+//сегменте - без счетчика, такая копия - вид, действительный пока держится мьютекс бд
+//(арену перестраивают и сегменты отпускают только под ним)
 class Document {
 private:
-    HashMap<string, string> data;
-    string id;
+    FieldDictionary* fields;
+    char* block;
+    bool owned;
 
-    bool evaluateCondition(const QueryCondition& condition, const HashMap<string, string>& docData) const;
+    struct Slot {
+        uint32_t fieldId;
+        uint32_t offset;
+        uint32_t length;
+    };
+    static const size_t HEADER_SIZE = 12;
+
+    uint32_t fieldCount() const;
+    const Slot* slots() const;
+    uint32_t slotValue(const Slot& slot, const char*& value, size_t& length) const;//код или NO_CODE
+    bool findValue(uint32_t fieldId, const char*& value, size_t& length, uint32_t& code) const;
+    bool conditionValue(const QueryCondition& condition, const char*& value, size_t& length, uint32_t& code) const;
+    void release();
+
+    bool evaluateCondition(const QueryCondition& condition) const;
     bool compareValues(const string& actual, const string& expected, ConditionType op, const string& field_name = "") const;
     bool compareTimestamps(const string& actual, const string& expected, bool greaterThan) const;
     bool likeMatch(const string& value, const string& pattern) const;
 
 public:
     Document();
-    Document(const string& jsonStr);
-    Document(const HashMap<string, string>& dataMap, const string& docId = "");
-    Document(const Document& other) = default;
-    Document& operator=(const Document& other) = default;
-    Document(Document&& other) noexcept = default;
-    Document& operator=(Document&& other) noexcept = default;
+    Document(const HashMap<string, string>& dataMap, const string& docId, FieldDictionary& dictionary);
+    ~Document();
+    Document(const Document& other);
+    Document& operator=(const Document& other);
+    Document(Document&& other) noexcept;
+    Document& operator=(Document&& other) noexcept;
+
     string getId() const;
-    void setData(const HashMap<string, string>& newData);
     HashMap<string, string> getData() const;
+    bool getField(const string& field, string& value) const;
+    bool getFieldById(uint32_t fieldId, string& value) const;//номер из словаря коллекции
     string to_json() const;
+    string serialize() const;//бинарное представление для журнала
+    static bool deserialize(const char* data, size_t len, Document& out, FieldDictionary& dictionary);
+    //вид на готовый блок в чужой памяти: проверяется только разметка, значения не читаются;
+    //номера полей и коды должны быть из dictionary, память живет дольше вида
+    static bool view(const char* data, size_t len, FieldDictionary& dictionary, Document& out);
     bool matchesCondition(const QueryCondition& condition) const;
+
+    bool empty() const { return block == nullptr; }
+    bool ownsBlock() const { return owned; }
+    size_t byteSize() const;
+    const char* bytes() const { return block; }//блок целиком, для сегмента и сравнения копий
+    //копия блока в арене, сам документ не меняется
+    Document copyTo(Arena& arena) const;
+
+    //граница $gt/$lt для timestamp: дата без времени расширяется до начала/конца дня
+    static string timestampBound(const string& expected, bool greaterThan);
+    static bool parseNumber(const string& str, double& out);
 };
 
-#endif
\ No newline at end of file
+#endif
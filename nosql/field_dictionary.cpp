@@ -0,0 +1,114 @@
+#include "field_dictionary.h"
+#include <iostream>
+
+ValueCodes::ValueCodes() : count(0) {
+    for (size_t i = 0; i < 8; i++) {
+        chunks[i] = nullptr;
+    }
+}
+
+ValueCodes::~ValueCodes() {
+    for (size_t i = 0; i < 8; i++) {
+        delete[] chunks[i];
+    }
+}
+
+FieldDictionary::FieldDictionary() : count(0) {
+    for (size_t i = 0; i < MAX_CHUNKS; i++) {
+        chunks[i] = nullptr;
+    }
+    intern("_id");
+}
+
+FieldDictionary::~FieldDictionary() {
+    uint32_t total = count.load();
+    for (uint32_t i = 0; i < total; i++) {
+        delete entry(i).values;
+    }
+    for (size_t i = 0; i < MAX_CHUNKS; i++) {
+        delete[] chunks[i];
+    }
+}
+
+uint32_t FieldDictionary::intern(const string& name) {
+    lock_guard<mutex> guard(lock);
+    uint32_t id;
+    if (ids.get(name, id)) {
+        return id;
+    }
+    id = count.load();
+    if (id >= CHUNK_SIZE * MAX_CHUNKS) {
+        cerr << "[FIELDS][ERROR] Too many distinct field names, dropping: " << name << endl;
+        return NOT_FOUND;
+    }
+    if (!chunks[id / CHUNK_SIZE]) {
+        chunks[id / CHUNK_SIZE] = new Entry[CHUNK_SIZE];
+    }
+    Entry& newEntry = chunks[id / CHUNK_SIZE][id % CHUNK_SIZE];
+    newEntry.name = name;
+    newEntry.values = new ValueCodes();
+    ids.put(name, id);
+    count.store(id + 1);//запись заполнена до публикации номера
+    return id;
+}
+
+uint32_t FieldDictionary::find(const string& name) const {
+    lock_guard<mutex> guard(lock);
+    uint32_t id;
+    return ids.get(name, id) ? id : NOT_FOUND;
+}
+
+uint32_t FieldDictionary::encode(uint32_t fieldId, const char* data, size_t length) {
+    ValueCodes* values = entry(fieldId).values;
+    lock_guard<mutex> guard(lock);
+    if (values->closed) {
+        return NO_CODE;//высокая кардинальность, строки дешевле словаря
+    }
+    string value(data, length);
+    uint32_t code;
+    if (values->codes.get(value, code)) {
+        return code;
+    }
+    code = values->count.load();
+    if (code >= VALUE_LIMIT) {
+        values->closed = true;
+        return NO_CODE;
+    }
+    size_t chunk = code / ValueCodes::CHUNK_SIZE;
+    if (!values->chunks[chunk]) {
+        values->chunks[chunk] = new string[ValueCodes::CHUNK_SIZE];
+    }
+    values->chunks[chunk][code % ValueCodes::CHUNK_SIZE] = value;
+    values->codes.put(value, code);
+    values->count.store(code + 1);
+    return code;
+}
+
+uint32_t FieldDictionary::findCode(uint32_t fieldId, const string& value) const {
+    const ValueCodes* values = entry(fieldId).values;
+    lock_guard<mutex> guard(lock);
+    uint32_t code;
+    return values->codes.get(value, code) ? code : NO_CODE;
+}
+
+void FieldDictionary::bind(QueryCondition& condition) const {
+    if (condition.type == ConditionType::AND || condition.type == ConditionType::OR) {
+        for (size_t i = 0; i < condition.subConditions.size(); i++) {
+            bind(condition.subConditions[i]);
+        }
+        return;
+    }
+    condition.fieldId = find(condition.field);//NOT_FOUND - поля нет ни в одном документе
+    condition.valueCode = NO_CODE;
+    condition.inCodes.clear();
+    if (condition.fieldId == NOT_FOUND || condition.fieldId == ID_FIELD) {
+        return;
+    }
+    if (condition.type == ConditionType::EQUAL) {
+        condition.valueCode = findCode(condition.fieldId, condition.value);
+    } else if (condition.type == ConditionType::IN) {
+        for (size_t i = 0; i < condition.inValues.size(); i++) {
+            condition.inCodes.push_back(findCode(condition.fieldId, condition.inValues[i]));
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef FIELD_DICTIONARY_H
+#define FIELD_DICTIONARY_H
+
+#include "HashMap.h"
+#include "QueryCondition.h"
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+using namespace std;
+
+//коды значений одного поля, пока различных значений не больше VALUE_LIMIT
+//после переполнения новые значения хранятся строками, выданные коды остаются
+struct ValueCodes {
+    static const size_t CHUNK_SIZE = 32;
+    HashMap<string, uint32_t> codes;
+    string* chunks[8];//VALUE_LIMIT / CHUNK_SIZE
+    atomic<uint32_t> count;
+    bool closed = false;
+
+    ValueCodes();
+    ~ValueCodes();
+};
+
+//имена полей коллекции -> короткие номера, каждое имя хранится один раз
+//номер 0 всегда _id, он берется из заголовка документа
+//name() и value() читаются без блокировки: выданные номер и код не переезжают
+class FieldDictionary {
+private:
+    static const size_t CHUNK_SIZE = 1024;
+    static const size_t MAX_CHUNKS = 256;
+
+    struct Entry {
+        string name;
+        ValueCodes* values = nullptr;
+    };
+
+    mutable mutex lock;
+    HashMap<string, uint32_t> ids;
+    Entry* chunks[MAX_CHUNKS];
+    atomic<uint32_t> count;
+
+    const Entry& entry(uint32_t id) const { return chunks[id / CHUNK_SIZE][id % CHUNK_SIZE]; }
+
+public:
+    static const uint32_t ID_FIELD = 0;
+    static const uint32_t NOT_FOUND = 0xFFFFFFFFu;
+    static const uint32_t NO_CODE = 0xFFFFFFFFu;
+    static const uint32_t VALUE_LIMIT = 256;//больше различных значений - поле не кодируется
+
+    FieldDictionary();
+    ~FieldDictionary();
+    FieldDictionary(const FieldDictionary&) = delete;
+    FieldDictionary& operator=(const FieldDictionary&) = delete;
+
+    uint32_t intern(const string& name);//NOT_FOUND, если словарь переполнен
+    uint32_t find(const string& name) const;//NOT_FOUND, если поле не встречалось
+    const string& name(uint32_t id) const { return entry(id).name; }
+
+    //код значения поля, новый код выдается, пока поле не переполнено
+    uint32_t encode(uint32_t fieldId, const char* data, size_t length);
+    uint32_t findCode(uint32_t fieldId, const string& value) const;//NO_CODE, если кода нет
+    const string& value(uint32_t fieldId, uint32_t code) const {
+        const ValueCodes* values = entry(fieldId).values;
+        return values->chunks[code / ValueCodes::CHUNK_SIZE][code % ValueCodes::CHUNK_SIZE];
+    }
+    uint32_t codeCount(uint32_t fieldId) const { return entry(fieldId).values->count.load(); }
+    //проставляет fieldId и коды значений $eq/$in во всем дереве условий,
+    //документы дальше ищут поле по номеру и сравнивают коды вместо строк
+    void bind(QueryCondition& condition) const;
+    uint32_t size() const { return count.load(); }
+};
+
+#endif
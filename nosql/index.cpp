@@ -0,0 +1,575 @@
+#include "index.h"
+#include <algorithm>
+
+bool parseIndexType(const string& str, IndexType& type) {
+    if (str == "hash") {
+        type = IndexType::HASH;
+        return true;
+    }
+    if (str == "ordered") {
+        type = IndexType::ORDERED;
+        return true;
+    }
+    if (str == "trigram") {
+        type = IndexType::TRIGRAM;
+        return true;
+    }
+    if (str == "bitmap") {
+        type = IndexType::BITMAP;
+        return true;
+    }
+    return false;
+}
+
+string indexTypeName(IndexType type) {
+    switch (type) {
+        case IndexType::HASH: return "hash";
+        case IndexType::ORDERED: return "ordered";
+        case IndexType::TRIGRAM: return "trigram";
+        case IndexType::BITMAP: return "bitmap";
+    }
+    return "hash";
+}
+
+PartitionIndex* PartitionIndex::create(IndexType type) {
+    switch (type) {
+        case IndexType::HASH: return new HashIndex();
+        case IndexType::ORDERED: return new OrderedIndex();
+        case IndexType::TRIGRAM: return new TrigramIndex();
+        case IndexType::BITMAP: return new BitmapIndex();
+    }
+    return nullptr;
+}
+
+//место номера в возрастающем списке
+static size_t lowerBound(const Vector<uint32_t>& list, uint32_t position) {
+    if (list.empty()) return 0;
+    return std::lower_bound(&list[0], &list[0] + list.size(), position) - &list[0];
+}
+
+static void addPosition(Vector<uint32_t>& list, uint32_t position) {
+    if (list.empty() || list.back() < position) {
+        list.push_back(position);//обычный случай: документ дописан в конец раздела
+        return;
+    }
+    size_t at = lowerBound(list, position);
+    if (at < list.size() && list[at] == position) return;
+    list.insert(at, &position, &position + 1);
+}
+
+static void removePosition(Vector<uint32_t>& list, uint32_t position) {
+    size_t at = lowerBound(list, position);
+    if (at < list.size() && list[at] == position) {
+        list.erase(at, at + 1);//пустой список остается за ключом до перестройки
+    }
+}
+
+void HashIndex::add(const string& value, uint32_t position) {
+    uint32_t slot;
+    if (!slots.get(value, slot)) {
+        slot = (uint32_t)postings.size();
+        slots.put(value, slot);
+        postings.emplace_back();
+    }
+    addPosition(postings[slot], position);
+}
+
+void HashIndex::remove(const string& value, uint32_t position) {
+    uint32_t slot;
+    if (slots.get(value, slot)) {
+        removePosition(postings[slot], position);
+    }
+}
+
+void HashIndex::clear() {
+    slots.clear();
+    postings.clear();
+}
+
+bool HashIndex::lookup(const QueryCondition& condition, Vector<uint32_t>& positions) const {
+    uint32_t slot;
+    positions.clear();
+    if (condition.type == ConditionType::EQUAL) {
+        if (slots.get(condition.value, slot)) {
+            positions = postings[slot];
+        }
+        return true;
+    }
+    if (condition.type == ConditionType::IN) {
+        Vector<uint32_t> merged;
+        for (size_t i = 0; i < condition.inValues.size(); i++) {
+            if (!slots.get(condition.inValues[i], slot)) continue;
+            unionPositions(positions, postings[slot], merged);
+            positions = std::move(merged);
+        }
+        return true;
+    }
+    return false;
+}
+
+size_t HashIndex::estimate(const QueryCondition& condition) const {
+    uint32_t slot;
+    if (condition.type == ConditionType::EQUAL) {
+        return slots.get(condition.value, slot) ? postings[slot].size() : 0;
+    }
+    if (condition.type == ConditionType::IN) {
+        size_t total = 0;
+        for (size_t i = 0; i < condition.inValues.size(); i++) {
+            if (slots.get(condition.inValues[i], slot)) total += postings[slot].size();
+        }
+        return total;
+    }
+    return NO_ESTIMATE;
+}
+
+size_t HashIndex::memoryBytes() const {
+    size_t bytes = slots.memoryBytes() + postings.memoryBytes();
+    for (const auto& entry : slots) {
+        bytes += entry.key.capacity() + postings[entry.value].memoryBytes();
+    }
+    return bytes;
+}
+
+OrderedIndex::~OrderedIndex() {
+    clear();
+}
+
+//лист, в который попадает запись: последний, чья первая запись не больше нее
+size_t OrderedIndex::findLeaf(const string& value, uint32_t position) const {
+    size_t low = 0, high = leaves.size();
+    while (high - low > 1) {
+        size_t middle = (low + high) / 2;
+        const Entry& first = leaves[middle]->entries[0];
+        int cmp = first.value.compare(value);
+        if (cmp < 0 || (cmp == 0 && first.position <= position)) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+//первая запись со значением больше value (inclusive - не меньше), leaves.size(), если таких нет
+size_t OrderedIndex::firstAbove(const string& value, bool inclusive, size_t& at) const {
+    auto above = [&](const Entry& entry) {
+        int cmp = entry.value.compare(value);
+        return cmp > 0 || (inclusive && cmp == 0);
+    };
+    //первый лист, который начинается выше границы; нужные записи могут быть в хвосте предыдущего
+    size_t low = 0, high = leaves.size();
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (above(leaves[middle]->entries[0])) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    size_t leaf = low > 0 ? low - 1 : 0;
+    for (; leaf < leaves.size(); leaf++) {
+        const Vector<Entry>& entries = leaves[leaf]->entries;
+        size_t first = 0, last = entries.size();
+        while (first < last) {
+            size_t middle = (first + last) / 2;
+            if (above(entries[middle])) {
+                last = middle;
+            } else {
+                first = middle + 1;
+            }
+        }
+        if (first < entries.size()) {
+            at = first;
+            return leaf;
+        }
+    }
+    at = 0;
+    return leaves.size();
+}
+
+//число записей от (fromLeaf, fromAt) до (toLeaf, toAt), правая граница не входит
+size_t OrderedIndex::countBetween(size_t fromLeaf, size_t fromAt, size_t toLeaf, size_t toAt) const {
+    if (fromLeaf > toLeaf || (fromLeaf == toLeaf && fromAt >= toAt)) {
+        return 0;
+    }
+    if (fromLeaf == toLeaf) {
+        return toAt - fromAt;
+    }
+    size_t count = leaves[fromLeaf]->entries.size() - fromAt + toAt;
+    for (size_t leaf = fromLeaf + 1; leaf < toLeaf; leaf++) {
+        count += leaves[leaf]->entries.size();//записи внутри не трогаются, только размеры листов
+    }
+    return count;
+}
+
+void OrderedIndex::add(const string& value, uint32_t position) {
+    if (leaves.empty()) {
+        leaves.push_back(new Leaf());
+    }
+    size_t leafIndex = findLeaf(value, position);
+    Vector<Entry>& entries = leaves[leafIndex]->entries;
+    auto before = [&](const Entry& entry) {//запись раньше (value, position)
+        int cmp = entry.value.compare(value);
+        return cmp < 0 || (cmp == 0 && entry.position < position);
+    };
+    Entry entry{value, position};
+    if (entries.empty() || before(entries.back())) {
+        entries.push_back(std::move(entry));
+    } else {
+        size_t first = 0, last = entries.size();
+        while (first < last) {
+            size_t middle = (first + last) / 2;
+            if (before(entries[middle])) {
+                first = middle + 1;
+            } else {
+                last = middle;
+            }
+        }
+        if (entries[first].position == position && entries[first].value == value) {
+            return;
+        }
+        entries.insert(first, &entry, &entry + 1);
+    }
+
+    if (entries.size() > LEAF_SIZE) {
+        //переполненный лист делится пополам, правая половина встает следующим листом
+        Leaf* right = new Leaf();
+        size_t half = entries.size() / 2;
+        right->entries.reserve(entries.size() - half);
+        for (size_t i = half; i < entries.size(); i++) {
+            right->entries.push_back(std::move(entries[i]));
+        }
+        entries.erase(half, entries.size());
+        leaves.insert(leafIndex + 1, &right, &right + 1);
+    }
+}
+
+void OrderedIndex::remove(const string& value, uint32_t position) {
+    if (leaves.empty()) return;
+    size_t leafIndex = findLeaf(value, position);
+    Vector<Entry>& entries = leaves[leafIndex]->entries;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].position == position && entries[i].value == value) {
+            entries.erase(i, i + 1);
+            break;
+        }
+    }
+    if (entries.empty()) {
+        delete leaves[leafIndex];
+        leaves.erase(leafIndex, leafIndex + 1);
+    }
+}
+
+void OrderedIndex::clear() {
+    for (size_t i = 0; i < leaves.size(); i++) {
+        delete leaves[i];
+    }
+    leaves.clear();
+}
+
+bool OrderedIndex::lookup(const QueryCondition& condition, Vector<uint32_t>& positions) const {
+    positions.clear();
+    if (condition.type == ConditionType::EQUAL) {
+        size_t at;
+        for (size_t leaf = firstAbove(condition.value, true, at); leaf < leaves.size(); leaf++, at = 0) {
+            const Vector<Entry>& entries = leaves[leaf]->entries;
+            for (; at < entries.size(); at++) {
+                if (entries[at].value != condition.value) return true;
+                positions.push_back(entries[at].position);
+            }
+        }
+        return true;
+    }
+    if (condition.type == ConditionType::IN) {
+        Vector<uint32_t> single, merged;
+        QueryCondition equal(ConditionType::EQUAL, condition.field);
+        for (size_t i = 0; i < condition.inValues.size(); i++) {
+            equal.value = condition.inValues[i];
+            lookup(equal, single);
+            unionPositions(positions, single, merged);
+            positions = std::move(merged);
+        }
+        return true;
+    }
+    return false;//$gt/$lt - через rangeLookup, границы по правилам поля знает коллекция
+}
+
+bool OrderedIndex::rangeLookup(const string* lower, const string* upper, Vector<uint32_t>& positions) const {
+    positions.clear();
+    size_t at = 0;
+    size_t leaf = lower ? firstAbove(*lower, false, at) : 0;
+    for (; leaf < leaves.size(); leaf++, at = 0) {
+        const Vector<Entry>& entries = leaves[leaf]->entries;
+        for (; at < entries.size(); at++) {
+            if (upper && entries[at].value.compare(*upper) >= 0) return true;
+            positions.push_back(entries[at].position);
+        }
+    }
+    return true;
+}
+
+size_t OrderedIndex::estimate(const QueryCondition& condition) const {
+    if (condition.type == ConditionType::EQUAL) {
+        size_t fromAt, toAt;
+        size_t fromLeaf = firstAbove(condition.value, true, fromAt);
+        size_t toLeaf = firstAbove(condition.value, false, toAt);
+        return countBetween(fromLeaf, fromAt, toLeaf, toAt);
+    }
+    if (condition.type == ConditionType::IN) {
+        size_t total = 0;
+        QueryCondition equal(ConditionType::EQUAL, condition.field);
+        for (size_t i = 0; i < condition.inValues.size(); i++) {
+            equal.value = condition.inValues[i];
+            total += estimate(equal);
+        }
+        return total;
+    }
+    return NO_ESTIMATE;
+}
+
+size_t OrderedIndex::rangeEstimate(const string* lower, const string* upper) const {
+    size_t fromAt = 0, toAt = 0;
+    size_t fromLeaf = lower ? firstAbove(*lower, false, fromAt) : 0;
+    size_t toLeaf = upper ? firstAbove(*upper, true, toAt) : leaves.size();
+    return countBetween(fromLeaf, fromAt, toLeaf, toAt);
+}
+
+size_t OrderedIndex::memoryBytes() const {
+    size_t bytes = leaves.memoryBytes();
+    for (size_t i = 0; i < leaves.size(); i++) {
+        const Vector<Entry>& entries = leaves[i]->entries;
+        bytes += sizeof(Leaf) + entries.memoryBytes();
+        for (size_t j = 0; j < entries.size(); j++) {
+            if (entries[j].value.capacity() > 15) {
+                bytes += entries[j].value.capacity();//короткие строки лежат в самой записи
+            }
+        }
+    }
+    return bytes;
+}
+
+void TrigramIndex::trigramsOf(const char* data, size_t length, Vector<uint32_t>& out) {
+    out.clear();
+    for (size_t i = 0; i + 3 <= length; i++) {
+        const unsigned char* p = (const unsigned char*)data + i;
+        out.push_back((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]);
+    }
+    if (out.size() > 1) {
+        std::sort(&out[0], &out[0] + out.size());
+        size_t unique = std::unique(&out[0], &out[0] + out.size()) - &out[0];
+        out.erase(unique, out.size());
+    }
+}
+
+void TrigramIndex::add(const string& value, uint32_t position) {
+    Vector<uint32_t> trigrams;
+    trigramsOf(value.data(), value.size(), trigrams);
+    for (size_t i = 0; i < trigrams.size(); i++) {
+        uint32_t slot;
+        if (!slots.get(trigrams[i], slot)) {
+            slot = (uint32_t)postings.size();
+            slots.put(trigrams[i], slot);
+            postings.emplace_back();
+        }
+        addPosition(postings[slot], position);
+    }
+}
+
+void TrigramIndex::remove(const string& value, uint32_t position) {
+    Vector<uint32_t> trigrams;
+    trigramsOf(value.data(), value.size(), trigrams);
+    for (size_t i = 0; i < trigrams.size(); i++) {
+        uint32_t slot;
+        if (slots.get(trigrams[i], slot)) {
+            removePosition(postings[slot], position);
+        }
+    }
+}
+
+void TrigramIndex::clear() {
+    slots.clear();
+    postings.clear();
+}
+
+//тройки каждого литерального куска без повторов: likeMatch сопоставляет кусок подряд идущими байтами
+bool TrigramIndex::requiredTrigrams(const string& pattern, Vector<uint32_t>& out) {
+    Vector<uint32_t> piece;
+    out.clear();
+    size_t start = 0;
+    while (start < pattern.size()) {
+        size_t end = pattern.find_first_of("%_", start);
+        if (end == string::npos) end = pattern.size();
+        trigramsOf(pattern.data() + start, end - start, piece);
+        for (size_t i = 0; i < piece.size(); i++) {
+            out.push_back(piece[i]);
+        }
+        start = end + 1;
+    }
+    if (out.empty()) {
+        return false;//кусков длиннее двух байт нет
+    }
+    if (out.size() > 1) {//одна тройка может встретиться в нескольких кусках
+        std::sort(&out[0], &out[0] + out.size());
+        out.erase(std::unique(&out[0], &out[0] + out.size()) - &out[0], out.size());
+    }
+    return true;
+}
+
+bool TrigramIndex::lookup(const QueryCondition& condition, Vector<uint32_t>& positions) const {
+    Vector<uint32_t> required;
+    if (condition.type != ConditionType::LIKE || !requiredTrigrams(condition.value, required)) {
+        return false;
+    }
+
+    //пересечение начинается с самого короткого списка
+    Vector<const Vector<uint32_t>*> lists;
+    for (size_t i = 0; i < required.size(); i++) {
+        uint32_t slot;
+        if (!slots.get(required[i], slot)) {
+            positions.clear();
+            return true;//такой тройки нет ни в одном документе
+        }
+        lists.push_back(&postings[slot]);
+    }
+    std::sort(&lists[0], &lists[0] + lists.size(), [](const Vector<uint32_t>* a, const Vector<uint32_t>* b) {
+        return a->size() < b->size();
+    });
+    positions = *lists[0];
+    Vector<uint32_t> merged;
+    for (size_t i = 1; i < lists.size() && !positions.empty(); i++) {
+        intersectPositions(positions, *lists[i], merged);
+        positions = std::move(merged);
+    }
+    return true;
+}
+
+size_t TrigramIndex::estimate(const QueryCondition& condition) const {
+    Vector<uint32_t> required;
+    if (condition.type != ConditionType::LIKE || !requiredTrigrams(condition.value, required)) {
+        return NO_ESTIMATE;
+    }
+    size_t shortest = NO_ESTIMATE;
+    for (size_t i = 0; i < required.size(); i++) {
+        uint32_t slot;
+        if (!slots.get(required[i], slot)) {
+            return 0;
+        }
+        shortest = std::min(shortest, postings[slot].size());
+    }
+    return shortest;
+}
+
+size_t TrigramIndex::memoryBytes() const {
+    size_t bytes = slots.memoryBytes() + postings.memoryBytes();
+    for (size_t i = 0; i < postings.size(); i++) {
+        bytes += postings[i].memoryBytes();
+    }
+    return bytes;
+}
+
+void BitmapIndex::add(const string& value, uint32_t position) {
+    uint32_t slot;
+    if (!slots.get(value, slot)) {
+        slot = (uint32_t)bitmaps.size();
+        slots.put(value, slot);
+        bitmaps.emplace_back();
+    }
+    bitmaps[slot].add(position);
+}
+
+void BitmapIndex::remove(const string& value, uint32_t position) {
+    uint32_t slot;
+    if (slots.get(value, slot)) {
+        bitmaps[slot].remove(position);
+    }
+}
+
+void BitmapIndex::clear() {
+    slots.clear();
+    bitmaps.clear();
+}
+
+bool BitmapIndex::lookup(const QueryCondition& condition, Vector<uint32_t>& positions) const {
+    Bitmap matches;
+    if (!bitmapLookup(condition, matches)) {
+        return false;
+    }
+    matches.toPositions(positions);
+    return true;
+}
+
+bool BitmapIndex::bitmapLookup(const QueryCondition& condition, Bitmap& matches) const {
+    uint32_t slot;
+    matches.clear();
+    if (condition.type == ConditionType::EQUAL) {
+        if (slots.get(condition.value, slot)) {
+            matches = bitmaps[slot];
+        }
+        return true;
+    }
+    if (condition.type == ConditionType::IN) {
+        for (size_t i = 0; i < condition.inValues.size(); i++) {
+            if (slots.get(condition.inValues[i], slot)) {
+                matches.uniteWith(bitmaps[slot]);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+size_t BitmapIndex::estimate(const QueryCondition& condition) const {
+    uint32_t slot;
+    if (condition.type == ConditionType::EQUAL) {
+        return slots.get(condition.value, slot) ? bitmaps[slot].cardinality() : 0;
+    }
+    if (condition.type == ConditionType::IN) {
+        size_t total = 0;
+        for (size_t i = 0; i < condition.inValues.size(); i++) {
+            if (slots.get(condition.inValues[i], slot)) total += bitmaps[slot].cardinality();
+        }
+        return total;
+    }
+    return NO_ESTIMATE;
+}
+
+size_t BitmapIndex::memoryBytes() const {
+    size_t bytes = slots.memoryBytes() + bitmaps.memoryBytes();
+    for (const auto& entry : slots) {
+        bytes += entry.key.capacity() + bitmaps[entry.value].memoryBytes();
+    }
+    return bytes;
+}
+
+void intersectPositions(const Vector<uint32_t>& a, const Vector<uint32_t>& b, Vector<uint32_t>& out) {
+    out.clear();
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            out.push_back(a[i]);
+            i++;
+            j++;
+        }
+    }
+}
+
+void unionPositions(const Vector<uint32_t>& a, const Vector<uint32_t>& b, Vector<uint32_t>& out) {
+    out.clear();
+    out.reserve(a.size() + b.size());
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        if (j >= b.size() || (i < a.size() && a[i] < b[j])) {
+            out.push_back(a[i++]);
+        } else if (i >= a.size() || b[j] < a[i]) {
+            out.push_back(b[j++]);
+        } else {
+            out.push_back(a[i]);
+            i++;
+            j++;
+        }
+    }
+}
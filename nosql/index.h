@@ -0,0 +1,159 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "HashMap.h"
+#include "vector.h"
+#include "QueryCondition.h"
+#include "bitmap.h"
+#include <string>
+#include <cstdint>
+using namespace std;
+
+enum class IndexType {
+    HASH,//значение -> документы, для $eq и $in
+    ORDERED,//значения по порядку, для $gt/$lt и выдачи по возрастанию значения
+    TRIGRAM,//тройки подряд идущих байт -> документы, для $like по свободному тексту
+    BITMAP//значение -> сжатая битовая карта, для полей с малым числом значений
+};
+
+bool parseIndexType(const string& str, IndexType& type);
+string indexTypeName(IndexType type);
+
+//объявленный индекс коллекции, хранится в .meta
+struct IndexSpec {
+    string field;
+    IndexType type = IndexType::HASH;
+};
+
+//индекс одного поля внутри раздела, хранит номера документов в разделе
+//удаленные документы остаются в индексе до сжатия (кроме точных, см. exact), их отсекает сам поиск
+class PartitionIndex {
+public:
+    virtual ~PartitionIndex() {}
+    virtual void add(const string& value, uint32_t position) = 0;
+    virtual void remove(const string& value, uint32_t position) = 0;//номера может и не быть
+    virtual void clear() = 0;
+    //номера документов, которые могут подойти под условие по полю индекса, по возрастанию;
+    //false - индекс на такое условие не отвечает
+    virtual bool lookup(const QueryCondition& condition, Vector<uint32_t>& positions) const = 0;
+    //значения строго между lower и upper (nullptr - без границы), номера в порядке значений;
+    //false - индекс порядка значений не хранит
+    virtual bool rangeLookup(const string* lower, const string* upper, Vector<uint32_t>& positions) const {
+        (void)lower; (void)upper; (void)positions;
+        return false;
+    }
+    //сколько номеров вернет lookup/rangeLookup, по длинам списков без их обхода;
+    //NO_ESTIMATE - индекс на условие не отвечает
+    static const size_t NO_ESTIMATE = (size_t)-1;
+    virtual size_t estimate(const QueryCondition& condition) const = 0;
+    virtual size_t rangeEstimate(const string* lower, const string* upper) const {
+        (void)lower; (void)upper;
+        return NO_ESTIMATE;
+    }
+    //точное множество живых документов для $eq/$in: такой индекс убирает документ сразу при удалении,
+    //а не при сжатии, поэтому его ответ не нужно проверять по документам
+    virtual bool exact() const { return false; }
+    virtual bool bitmapLookup(const QueryCondition& condition, Bitmap& matches) const {
+        (void)condition; (void)matches;
+        return false;
+    }
+    virtual size_t memoryBytes() const = 0;
+
+    static PartitionIndex* create(IndexType type);
+};
+
+//значение -> номера документов по возрастанию: новые документы всегда в конце раздела
+class HashIndex : public PartitionIndex {
+private:
+    HashMap<string, uint32_t> slots;//значение -> номер списка
+    Vector<Vector<uint32_t>> postings;
+
+public:
+    void add(const string& value, uint32_t position) override;
+    void remove(const string& value, uint32_t position) override;
+    void clear() override;
+    bool lookup(const QueryCondition& condition, Vector<uint32_t>& positions) const override;
+    size_t estimate(const QueryCondition& condition) const override;
+    size_t memoryBytes() const override;
+};
+
+//B+-дерево в два уровня: отсортированные листы до LEAF_SIZE записей и массив листов по порядку
+//записи упорядочены по (значение, номер), так равные значения идут в порядке вставки
+//метки времени почти всегда растут, поэтому вставка обычно попадает в конец последнего листа
+class OrderedIndex : public PartitionIndex {
+private:
+    static const size_t LEAF_SIZE = 256;
+
+    struct Entry {
+        string value;
+        uint32_t position;
+    };
+    struct Leaf {
+        Vector<Entry> entries;
+    };
+
+    Vector<Leaf*> leaves;
+
+    size_t findLeaf(const string& value, uint32_t position) const;
+    size_t firstAbove(const string& value, bool inclusive, size_t& at) const;//лист и место первой записи
+    size_t countBetween(size_t fromLeaf, size_t fromAt, size_t toLeaf, size_t toAt) const;
+
+public:
+    OrderedIndex() = default;
+    ~OrderedIndex();
+    OrderedIndex(const OrderedIndex&) = delete;
+    OrderedIndex& operator=(const OrderedIndex&) = delete;
+
+    void add(const string& value, uint32_t position) override;
+    void remove(const string& value, uint32_t position) override;
+    void clear() override;
+    bool lookup(const QueryCondition& condition, Vector<uint32_t>& positions) const override;
+    bool rangeLookup(const string* lower, const string* upper, Vector<uint32_t>& positions) const override;
+    size_t estimate(const QueryCondition& condition) const override;
+    size_t rangeEstimate(const string* lower, const string* upper) const override;
+    size_t memoryBytes() const override;
+};
+
+//тройка байт значения -> номера документов по возрастанию
+//$like раскладывается на литеральные куски между % и _, документ годится, только если
+//в нем есть все тройки всех кусков; кандидатов потом проверяет обычный likeMatch
+class TrigramIndex : public PartitionIndex {
+private:
+    HashMap<uint32_t, uint32_t> slots;//тройка -> номер списка
+    Vector<Vector<uint32_t>> postings;
+
+    static void trigramsOf(const char* data, size_t length, Vector<uint32_t>& out);//без повторов
+    static bool requiredTrigrams(const string& pattern, Vector<uint32_t>& out);//false - сузить нечем
+
+public:
+    void add(const string& value, uint32_t position) override;
+    void remove(const string& value, uint32_t position) override;
+    void clear() override;
+    bool lookup(const QueryCondition& condition, Vector<uint32_t>& positions) const override;
+    size_t estimate(const QueryCondition& condition) const override;//самый короткий из нужных списков
+    size_t memoryBytes() const override;
+};
+
+//значение -> битовая карта номеров; $and/$or/$in по таким полям считаются пересечением
+//и объединением карт, а число совпадений - суммой их мощностей, без обращения к документам
+class BitmapIndex : public PartitionIndex {
+private:
+    HashMap<string, uint32_t> slots;//значение -> номер карты
+    Vector<Bitmap> bitmaps;
+
+public:
+    void add(const string& value, uint32_t position) override;
+    void remove(const string& value, uint32_t position) override;
+    void clear() override;
+    bool lookup(const QueryCondition& condition, Vector<uint32_t>& positions) const override;
+    bool exact() const override { return true; }
+    bool bitmapLookup(const QueryCondition& condition, Bitmap& matches) const override;
+    size_t estimate(const QueryCondition& condition) const override;//точное число по мощностям карт
+    size_t memoryBytes() const override;
+};
+
+//операции над возрастающими списками номеров
+void intersectPositions(const Vector<uint32_t>& a, const Vector<uint32_t>& b, Vector<uint32_t>& out);
+void unionPositions(const Vector<uint32_t>& a, const Vector<uint32_t>& b, Vector<uint32_t>& out);
+
+#endif
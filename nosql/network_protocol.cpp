@@ -47,6 +47,9 @@ string Request::toJson() const {
     }
     json << ",\"page\":" << page;
     json << ",\"limit\":" << limit;
+    if (!durability.empty()) {
+        json << ",\"durability\":\"" << durability << "\"";
+    }
     
     json << ",\"data\":[";
     for (size_t i = 0; i < data.size(); ++i) {
@@ -71,9 +74,11 @@ string Request::toJson() const {
     return json.str();
 }
 
-Request Request::fromJson(const string& jsonStr) {    
+Request Request::fromJson(const string& jsonStr, Allocator* scratch) {
     Request req;
-    JsonParser parser;
+    req.scratch = scratch;
+    req.data = Vector<string>(scratch);
+    JsonParser parser(scratch);
     try {
         HashMap<string, string> parsed = parser.parse(jsonStr);
         string value;
@@ -121,21 +126,27 @@ Request Request::fromJson(const string& jsonStr) {
             }
         }
         
+        if (parsed.contains("durability")) {
+            if (parsed.get("durability", value)) {
+                req.durability = value;
+            }
+        }
+        
         if (parsed.contains("data")) {
             string dataStr;
             if (parsed.get("data", dataStr)) {
                 if (dataStr.size() >= 2 && dataStr[0] == '[' && dataStr[dataStr.size()-1] == ']') {
                     Vector<HashMap<string, string>> dataArray = parser.parseArray(dataStr);
                     for (size_t i = 0; i < dataArray.size(); i++) {
-                        HashMap<string, string> item = dataArray[i];
                         ostringstream itemJson;
                         itemJson << "{";
-                        auto items = item.items();
-                        for (size_t j = 0; j < items.size(); j++) {
-                            if (j > 0) itemJson << ",";
-                            itemJson << "\"" << items[j].first << "\":";
+                        bool firstField = true;
+                        for (const auto& entry : dataArray[i]) {
+                            if (!firstField) itemJson << ",";
+                            firstField = false;
+                            itemJson << "\"" << entry.key << "\":";
                             
-                            string val = items[j].second;
+                            const string& val = entry.value;
                             if (val.empty() || 
                                 (val[0] != '{' && val[0] != '[' && 
                                  val != "true" && val != "false" && val != "null" &&
@@ -158,7 +169,7 @@ Request Request::fromJson(const string& jsonStr) {
     return req;
 }
 
-string Response::toJson() const {
+string Response::toJson(Allocator* scratch) const {
     ostringstream json;
     json << "{";
     json << "\"status\":\"" << status << "\",";
@@ -168,6 +179,9 @@ string Response::toJson() const {
     json << "\"current_page\":" << current_page << ",";
     json << "\"per_page\":" << per_page << ",";
     json << "\"total_count\":" << total_count << ",";
+    if (!durability.empty()) {
+        json << "\"durability\":\"" << durability << "\",";
+    }
     
     json << "\"data\":[";
     for (size_t i = 0; i < data.size(); ++i) {
@@ -177,7 +191,7 @@ string Response::toJson() const {
             ((data[i][0] == '{' && data[i][data[i].size()-1] == '}') ||
              (data[i][0] == '[' && data[i][data[i].size()-1] == ']'))) {
             
-            JsonParser parser;
+            JsonParser parser(scratch);//разбор только для проверки, результат не нужен
             try {
                 if (data[i][0] == '{') {
                     HashMap<string, string> parsed = parser.parse(data[i]);
@@ -217,6 +231,12 @@ Response Response::fromJson(const string& json) {
             }
         }
         
+        if (parsed.contains("durability")) {
+            if (parsed.get("durability", value)) {
+                resp.durability = value;
+            }
+        }
+        
         if (parsed.contains("count")) {
             string countStr;
             if (parsed.get("count", countStr)) {
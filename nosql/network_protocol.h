@@ -18,9 +18,12 @@ public:
     Vector<string> data;
     int page = 1;
     int limit = 50;
+    string durability;//пусто - режим бд по умолчанию
+    Allocator* scratch = nullptr;//память на время обработки запроса, не сериализуется
     
     string toJson() const;
-    static Request fromJson(const string& jsonStr);
+    //временные разборы и data берут память из scratch, если он есть
+    static Request fromJson(const string& jsonStr, Allocator* scratch = nullptr);
 };
 
 class Response {
@@ -33,8 +36,9 @@ public:
     int current_page = 1;
     int per_page = 50;
     size_t total_count = 0;
+    string durability;//фактический режим для операций записи
     
-    string toJson() const;
+    string toJson(Allocator* scratch = nullptr) const;
     static Response fromJson(const string& jsonStr);
 };
 
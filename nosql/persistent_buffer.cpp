@@ -58,9 +58,9 @@ bool PersistentBuffer::addEvents(const Vector<SecurityEvent>& events) {
         memory_buffer.clear();
     }
     
-    for (size_t i = 0; i < events.size(); i++) {
-        memory_buffer.push_back(events[i]);
-        total_events_stored++;
+    if (!events.empty()) {
+        memory_buffer.insert(memory_buffer.size(), &events[0], &events[0] + events.size());
+        total_events_stored += events.size();
     }
     return true;
 }
@@ -71,23 +71,14 @@ Vector<SecurityEvent> PersistentBuffer::getBatch(size_t batch_size) {
     Vector<SecurityEvent> batch;
     
     size_t from_memory = min(batch_size, memory_buffer.size());//из памяти
+    batch.reserve(from_memory);
     for (size_t i = 0; i < from_memory; i++) {
-        batch.push_back(memory_buffer[i]);
-    }
-    
-    if (from_memory > 0) {//удаляем
-        Vector<SecurityEvent> new_buffer;
-        for (size_t i = from_memory; i < memory_buffer.size(); i++) {
-            new_buffer.push_back(memory_buffer[i]);
-        }
-        memory_buffer = new_buffer;
+        batch.push_back(std::move(memory_buffer[i]));
     }
+    memory_buffer.erase(0, from_memory);//остаток сдвигается перемещением
     
     if (batch.size() < batch_size) {
-        Vector<SecurityEvent> disk_events = loadFromDiskBatch(batch_size - batch.size());
-        for (size_t i = 0; i < disk_events.size(); i++) {
-            batch.push_back(disk_events[i]);
-        }
+        batch.append(loadFromDiskBatch(batch_size - batch.size()));
     }
     
     return batch;
@@ -193,7 +184,7 @@ Vector<SecurityEvent> PersistentBuffer::loadFromDiskBatch(size_t batch_size) {
                 if (event_map.get("raw_log", value)) event.raw_log = value;
                 if (event_map.get("agent_id", value)) event.agent_id = value;
                 
-                events.push_back(event);
+                events.push_back(std::move(event));
                 loaded++;
             } catch (...) {
                 cerr << "ERROR: Failed to parse event from disk" << endl;
@@ -0,0 +1,511 @@
+#include "query_planner.h"
+#include "collection.h"
+#include "document.h"
+#include "field_dictionary.h"
+#include <algorithm>
+#include <cmath>
+
+//цены в проверках документа при полном обходе
+static const double SCAN_COST = 1.0;//документ подряд: блок из арены и проверка условия
+static const double CANDIDATE_COST = 1.5;//кандидат из индекса: переход по номеру и та же проверка
+static const double LIST_COST = 0.05;//номер из списка или листа индекса
+static const double BITMAP_COST = 0.01;//номер в операции над картами, они идут словами по 64
+static const double PROBE_COST = 0.2;//двоичный поиск кандидата в списке фильтра
+static const double FETCH_COST = 0.5;//значение поля кандидата для сортировки по нему
+static const double SORT_COST = 0.1;//одно сравнение при сортировке
+
+static double sortCost(double count) {
+    return count > 1 ? count * std::log2(count) * SORT_COST : 0;
+}
+
+static void sortPositions(Vector<uint32_t>& positions) {
+    if (positions.size() > 1) {
+        std::sort(&positions[0], &positions[0] + positions.size());
+    }
+}
+
+QueryPlanner::QueryPlanner(const CollectionOptions& options, const Vector<uint32_t>& fieldIds,
+                           const Partition& partition)
+    : options(options), fieldIds(fieldIds), partition(partition), rows(partition.documents.size()) {
+}
+
+//доля документов раздела, которую пропускает условие с такой оценкой
+double QueryPlanner::selectivity(size_t estimate) const {
+    return rows == 0 ? 0 : std::min(1.0, (double)estimate / rows);
+}
+
+double QueryPlanner::totalCost(const PlanNode& plan) const {
+    if (plan.kind == PlanKind::FULL_SCAN || plan.exact) {
+        return plan.cost;
+    }
+    return plan.cost + plan.estimate * CANDIDATE_COST;
+}
+
+PlanNode QueryPlanner::plan(const QueryCondition& bound) const {
+    PlanNode scan;
+    scan.estimate = partition.liveCount();
+    scan.cost = scan.estimate * SCAN_COST;
+    PlanNode indexed;
+    if (options.indexes.empty()) {
+        return scan;
+    }
+    if (planExact(bound, indexed)) {
+        indexed.exact = true;
+        return indexed;//карты дешевле обхода при любой оценке
+    }
+    if (!planIndex(bound, indexed)) {
+        return scan;
+    }
+    //выдача по диапазону идет в порядке значений, полный обход такого порядка не дает
+    if (indexed.orderIndex >= 0 || totalCost(indexed) < totalCost(scan)) {
+        return indexed;
+    }
+    return scan;
+}
+
+//условие целиком по bitmap-индексам: $eq/$in по их полям, $and и $or из таких условий
+//оценка $and - в предположении, что поля независимы
+bool QueryPlanner::planExact(const QueryCondition& condition, PlanNode& node) const {
+    node = PlanNode();
+    node.kind = PlanKind::BITMAP;
+    node.condition = &condition;
+    if (condition.type == ConditionType::AND || condition.type == ConditionType::OR) {
+        if (condition.subConditions.empty()) {
+            return false;//пустое $and - все документы, карт для этого нет
+        }
+        bool conjunction = condition.type == ConditionType::AND;
+        double fraction = 1;
+        size_t total = 0;
+        PlanNode sub;
+        for (size_t i = 0; i < condition.subConditions.size(); i++) {
+            if (!planExact(condition.subConditions[i], sub)) {
+                return false;
+            }
+            node.cost += sub.cost;
+            fraction *= selectivity(sub.estimate);
+            total += sub.estimate;
+        }
+        node.estimate = conjunction ? (size_t)std::ceil(fraction * rows) : std::min(total, rows);
+        return true;
+    }
+    int index = options.findIndex(condition.field);
+    if (index < 0 || !partition.indexes[index]->exact()) {
+        return false;
+    }
+    size_t estimate = partition.indexes[index]->estimate(condition);
+    if (estimate == PartitionIndex::NO_ESTIMATE) {
+        return false;
+    }
+    node.index = index;
+    node.estimate = estimate;
+    node.cost = estimate * BITMAP_COST;
+    return true;
+}
+
+//false - индексы условие не сужают, без полного обхода не обойтись
+bool QueryPlanner::planIndex(const QueryCondition& condition, PlanNode& node) const {
+    if (planExact(condition, node)) {
+        return true;
+    }
+    switch (condition.type) {
+        case ConditionType::AND:
+            return planAnd(condition, node);
+        case ConditionType::OR: {
+            node = PlanNode();
+            node.kind = PlanKind::UNION;
+            size_t total = 0;
+            for (size_t i = 0; i < condition.subConditions.size(); i++) {
+                PlanNode sub;
+                if (!planIndex(condition.subConditions[i], sub)) {
+                    return false;//одна ветвь без индекса - все равно обходить все
+                }
+                node.cost += sub.cost + sub.estimate * LIST_COST;//слияние списков
+                if (sub.orderIndex >= 0) {
+                    node.cost += sortCost(sub.estimate);
+                }
+                total += sub.estimate;
+                node.children.push_back(std::move(sub));
+            }
+            node.estimate = std::min(total, rows);
+            return true;
+        }
+        default: {
+            int index = options.findIndex(condition.field);
+            if (index < 0) {
+                return false;
+            }
+            size_t estimate = partition.indexes[index]->estimate(condition);
+            if (estimate == PartitionIndex::NO_ESTIMATE) {
+                return false;
+            }
+            node = PlanNode();
+            node.kind = PlanKind::LOOKUP;
+            node.condition = &condition;
+            node.index = index;
+            node.estimate = estimate;
+            node.cost = estimate * LIST_COST;
+            return true;
+        }
+    }
+}
+
+//источники кандидатов $and: карты точных ветвей, диапазоны по упорядоченным индексам, остальные ветви
+//ведет самый узкий; диапазон сохраняет свой порядок значений, либо ведя сам,
+//либо через сортировку кандидатов узкого индекса - берется что дешевле
+bool QueryPlanner::planAnd(const QueryCondition& condition, PlanNode& node) const {
+    Vector<PlanNode> sources;
+    Vector<bool, 8> consumed;
+    PlanNode exact, sub;
+    exact.kind = PlanKind::BITMAP;
+    double fraction = 1;
+    for (size_t i = 0; i < condition.subConditions.size(); i++) {
+        consumed.push_back(false);
+        if (!planExact(condition.subConditions[i], sub)) continue;
+        consumed[i] = true;
+        exact.cost += sub.cost;
+        fraction *= selectivity(sub.estimate);
+        exact.children.push_back(std::move(sub));
+    }
+    if (exact.children.size() == 1) {
+        sources.push_back(std::move(exact.children[0]));
+    } else if (exact.children.size() > 1) {
+        exact.estimate = (size_t)std::ceil(fraction * rows);//пересекаются картами, в список - один раз
+        sources.push_back(std::move(exact));
+    }
+
+    //$gt и $lt одного поля - один проход по диапазону, из нескольких границ берется самая узкая
+    //числовые границы сравниваются как числа, а индекс упорядочен как строки - их не берем
+    Vector<PlanNode, 2> ranges;
+    double number;
+    for (size_t i = 0; i < condition.subConditions.size(); i++) {
+        const QueryCondition& child = condition.subConditions[i];
+        bool greater = child.type == ConditionType::GREATER_THAN;
+        int index = options.findIndex(child.field);
+        if (consumed[i] || (!greater && child.type != ConditionType::LESS_THAN) || index < 0 ||
+            options.indexes[index].type != IndexType::ORDERED || Document::parseNumber(child.value, number)) {
+            continue;
+        }
+        string bound = child.field == "timestamp" ? Document::timestampBound(child.value, greater) : child.value;
+        size_t r = 0;
+        while (r < ranges.size() && ranges[r].index != index) r++;
+        if (r == ranges.size()) {
+            ranges.emplace_back();
+            ranges[r].kind = PlanKind::RANGE;
+            ranges[r].index = index;
+            ranges[r].orderIndex = index;
+        }
+        PlanNode& range = ranges[r];
+        if (greater && (!range.hasLower || bound > range.lower)) {
+            range.lower = std::move(bound);
+            range.hasLower = true;
+        } else if (!greater && (!range.hasUpper || bound < range.upper)) {
+            range.upper = std::move(bound);
+            range.hasUpper = true;
+        }
+        consumed[i] = true;
+    }
+    for (size_t r = 0; r < ranges.size(); r++) {
+        PlanNode& range = ranges[r];
+        range.estimate = partition.indexes[range.index]->rangeEstimate(range.hasLower ? &range.lower : nullptr,
+                                                                       range.hasUpper ? &range.upper : nullptr);
+        range.cost = range.estimate * LIST_COST;
+        sources.push_back(std::move(range));
+    }
+
+    for (size_t i = 0; i < condition.subConditions.size(); i++) {
+        if (!consumed[i] && planIndex(condition.subConditions[i], sub)) {
+            sources.push_back(std::move(sub));
+        }
+    }
+    if (sources.empty()) {
+        return false;
+    }
+
+    Vector<const PlanNode*> order;
+    for (size_t i = 0; i < sources.size(); i++) {
+        order.push_back(&sources[i]);
+    }
+    std::stable_sort(&order[0], &order[0] + order.size(), [](const PlanNode* a, const PlanNode* b) {
+        return a->estimate < b->estimate;
+    });
+    size_t ordered = 0;
+    while (ordered < order.size() && order[ordered]->orderIndex < 0) ordered++;
+    if (ordered == order.size()) {
+        node = intersect(order, 0, -1);
+        return true;
+    }
+    node = intersect(order, ordered, -1);
+    if (ordered > 0) {
+        PlanNode sorted = intersect(order, 0, order[ordered]->orderIndex);
+        if (totalCost(sorted) < totalCost(node)) {
+            node = std::move(sorted);
+        }
+    }
+    return true;
+}
+
+//ведущий источник и те из остальных (по возрастанию оценки), что окупаются:
+//фильтр берется, если отсеянные им кандидаты стоили бы больше, чем его список и поиск в нем
+PlanNode QueryPlanner::intersect(const Vector<const PlanNode*>& sources, size_t driver, int sortIndex) const {
+    PlanNode node;
+    node.kind = PlanKind::INTERSECT;
+    node.children.push_back(*sources[driver]);
+    node.cost = sources[driver]->cost;
+    double remaining = sources[driver]->estimate;
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (i == driver) continue;
+        const PlanNode& filter = *sources[i];
+        double fraction = selectivity(filter.estimate);
+        double filterCost = filter.cost + remaining * PROBE_COST;
+        if (filter.orderIndex >= 0) {
+            filterCost += sortCost(filter.estimate);//для поиска список нужен по возрастанию номеров
+        }
+        if (remaining * (1 - fraction) * CANDIDATE_COST <= filterCost) continue;
+        node.children.push_back(filter);
+        node.cost += filterCost;
+        remaining *= fraction;
+    }
+    node.estimate = (size_t)std::ceil(remaining);
+    node.orderIndex = node.children[0].orderIndex;
+    if (sortIndex >= 0) {
+        node.sortIndex = sortIndex;
+        node.orderIndex = sortIndex;
+        node.cost += remaining * FETCH_COST + sortCost(remaining);
+    } else if (node.children.size() == 1) {
+        return std::move(node.children[0]);
+    }
+    return node;
+}
+
+void QueryPlanner::candidates(const PlanNode& plan, Vector<uint32_t>& positions) const {
+    switch (plan.kind) {
+        case PlanKind::FULL_SCAN:
+            positions.clear();
+            return;
+        case PlanKind::BITMAP: {
+            Bitmap matches;
+            bitmapMatches(plan, matches);
+            matches.toPositions(positions);
+            return;
+        }
+        case PlanKind::LOOKUP:
+            partition.indexes[plan.index]->lookup(*plan.condition, positions);
+            return;
+        case PlanKind::RANGE:
+            partition.indexes[plan.index]->rangeLookup(plan.hasLower ? &plan.lower : nullptr,
+                                                       plan.hasUpper ? &plan.upper : nullptr, positions);
+            return;
+        case PlanKind::INTERSECT: {
+            //порядок ведущего сохраняется, остальные только отсеивают
+            candidates(plan.children[0], positions);
+            Vector<uint32_t> filter;
+            for (size_t c = 1; c < plan.children.size() && !positions.empty(); c++) {
+                candidates(plan.children[c], filter);
+                if (plan.children[c].orderIndex >= 0) {
+                    sortPositions(filter);
+                }
+                size_t kept = 0;
+                for (size_t i = 0; i < positions.size(); i++) {
+                    if (!filter.empty() && std::binary_search(&filter[0], &filter[0] + filter.size(), positions[i])) {
+                        positions[kept++] = positions[i];
+                    }
+                }
+                positions.erase(kept, positions.size());
+            }
+            if (plan.sortIndex >= 0) {
+                sortByValue(positions, plan.sortIndex);
+            }
+            return;
+        }
+        case PlanKind::UNION: {
+            Vector<uint32_t> sub, merged;
+            positions.clear();
+            for (size_t c = 0; c < plan.children.size(); c++) {
+                candidates(plan.children[c], sub);
+                if (plan.children[c].orderIndex >= 0) {
+                    sortPositions(sub);
+                }
+                unionPositions(positions, sub, merged);
+                positions = std::move(merged);
+            }
+            return;
+        }
+    }
+}
+
+void QueryPlanner::bitmapMatches(const PlanNode& plan, Bitmap& matches) const {
+    if (plan.condition) {
+        exactMatches(*plan.condition, matches);
+        return;
+    }
+    Bitmap sub;
+    for (size_t c = 0; c < plan.children.size(); c++) {
+        bitmapMatches(plan.children[c], c == 0 ? matches : sub);
+        if (c > 0) {
+            matches.intersectWith(sub);
+        }
+    }
+}
+
+//точное множество живых документов раздела: $and - пересечение карт, $or - объединение
+bool QueryPlanner::exactMatches(const QueryCondition& condition, Bitmap& matches) const {
+    if (condition.type == ConditionType::AND || condition.type == ConditionType::OR) {
+        if (condition.subConditions.empty()) {
+            return false;
+        }
+        Bitmap sub;
+        for (size_t i = 0; i < condition.subConditions.size(); i++) {
+            if (!exactMatches(condition.subConditions[i], i == 0 ? matches : sub)) {
+                return false;
+            }
+            if (i == 0) continue;
+            if (condition.type == ConditionType::AND) {
+                matches.intersectWith(sub);
+            } else {
+                matches.uniteWith(sub);
+            }
+        }
+        return true;
+    }
+    int index = options.findIndex(condition.field);
+    return index >= 0 && partition.indexes[index]->bitmapLookup(condition, matches);
+}
+
+//в порядке (значение, номер), как записи упорядоченного индекса
+void QueryPlanner::sortByValue(Vector<uint32_t>& positions, int index) const {
+    struct Keyed {
+        string value;
+        uint32_t position;
+    };
+    Vector<Keyed> keyed;
+    keyed.reserve(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        keyed.emplace_back();
+        keyed.back().position = positions[i];
+        partition.documents[positions[i]].getFieldById(fieldIds[index], keyed.back().value);
+    }
+    if (keyed.size() > 1) {
+        std::sort(&keyed[0], &keyed[0] + keyed.size(), [](const Keyed& a, const Keyed& b) {
+            int cmp = a.value.compare(b.value);
+            return cmp < 0 || (cmp == 0 && a.position < b.position);
+        });
+    }
+    for (size_t i = 0; i < keyed.size(); i++) {
+        positions[i] = keyed[i].position;
+    }
+}
+
+string QueryPlanner::describe(const PlanNode& plan) const {
+    string text;
+    switch (plan.kind) {
+        case PlanKind::FULL_SCAN:
+            text = "FULL_SCAN";
+            break;
+        case PlanKind::BITMAP:
+            if (plan.condition) {
+                text = "BITMAP " + describeCondition(*plan.condition);
+            } else {
+                text = "BITMAP (";
+                for (size_t c = 0; c < plan.children.size(); c++) {
+                    text += (c > 0 ? " AND " : "") + describeCondition(*plan.children[c].condition);
+                }
+                text += ")";
+            }
+            break;
+        case PlanKind::LOOKUP:
+            text = "LOOKUP " + indexTypeName(options.indexes[plan.index].type) + " " +
+                   describeCondition(*plan.condition);
+            break;
+        case PlanKind::RANGE:
+            text = "RANGE ordered " + options.indexes[plan.index].field + (plan.hasLower ? " $gt" : "") +
+                   (plan.hasUpper ? " $lt" : "");
+            break;
+        case PlanKind::INTERSECT:
+        case PlanKind::UNION:
+            text = plan.kind == PlanKind::INTERSECT ? "INTERSECT(" : "UNION(";
+            for (size_t c = 0; c < plan.children.size(); c++) {
+                text += (c > 0 ? ", " : "") + describe(plan.children[c]);
+            }
+            text += ")";
+            if (plan.sortIndex >= 0) {
+                text += " SORT BY " + options.indexes[plan.sortIndex].field;
+            }
+            break;
+    }
+    return text + (plan.exact ? " exact" : "") + " ~" + to_string(plan.estimate);
+}
+
+//поля и операции без значений: по описанию видно, что проверяется и в каком порядке
+string QueryPlanner::describeCondition(const QueryCondition& condition) {
+    switch (condition.type) {
+        case ConditionType::AND:
+        case ConditionType::OR: {
+            if (condition.subConditions.size() == 1) {
+                return describeCondition(condition.subConditions[0]);//обертка разбора вокруг объекта
+            }
+            string text = "(";
+            for (size_t i = 0; i < condition.subConditions.size(); i++) {
+                if (i > 0) {
+                    text += condition.type == ConditionType::AND ? " AND " : " OR ";
+                }
+                text += describeCondition(condition.subConditions[i]);
+            }
+            return text + ")";
+        }
+        case ConditionType::EQUAL: return condition.field + " $eq";
+        case ConditionType::GREATER_THAN: return condition.field + " $gt";
+        case ConditionType::LESS_THAN: return condition.field + " $lt";
+        case ConditionType::LIKE: return condition.field + " $like";
+        case ConditionType::IN: return condition.field + " $in[" + to_string(condition.inValues.size()) + "]";
+    }
+    return condition.field;
+}
+
+//примерная цена проверки условия на одном документе
+static double predicateCost(const QueryCondition& condition) {
+    if (condition.type == ConditionType::AND || condition.type == ConditionType::OR) {
+        double cost = 0;
+        for (size_t i = 0; i < condition.subConditions.size(); i++) {
+            cost += predicateCost(condition.subConditions[i]);
+        }
+        return cost;
+    }
+    if (condition.fieldId == FieldDictionary::NOT_FOUND) {
+        return 0.5;//поля нет ни в одном документе, ответ без чтения значения
+    }
+    switch (condition.type) {
+        case ConditionType::EQUAL: return 1;//код значения или memcmp
+        case ConditionType::IN: return 1 + condition.inValues.size() * 0.25;
+        case ConditionType::GREATER_THAN:
+        case ConditionType::LESS_THAN: return 6;//копия значения и попытка разобрать оба как числа
+        case ConditionType::LIKE: return 8 + condition.value.size() * 0.25;
+        default: return 1;
+    }
+}
+
+void QueryPlanner::orderPredicates(QueryCondition& condition) {
+    if (condition.type != ConditionType::AND && condition.type != ConditionType::OR) {
+        return;
+    }
+    size_t count = condition.subConditions.size();
+    for (size_t i = 0; i < count; i++) {
+        orderPredicates(condition.subConditions[i]);
+    }
+    if (count < 2) {
+        return;
+    }
+    Vector<pair<double, size_t>, 8> order;
+    for (size_t i = 0; i < count; i++) {
+        order.push_back(make_pair(predicateCost(condition.subConditions[i]), i));
+    }
+    //при равной цене остается порядок запроса
+    std::stable_sort(&order[0], &order[0] + count, [](const pair<double, size_t>& a, const pair<double, size_t>& b) {
+        return a.first < b.first;
+    });
+    Vector<QueryCondition> sorted;
+    sorted.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        sorted.push_back(std::move(condition.subConditions[order[i].second]));
+    }
+    condition.subConditions = std::move(sorted);
+}
@@ -0,0 +1,77 @@
+#ifndef QUERY_PLANNER_H
+#define QUERY_PLANNER_H
+
+#include "QueryCondition.h"
+#include "index.h"
+#include "bitmap.h"
+#include "vector.h"
+#include <string>
+#include <cstdint>
+using namespace std;
+
+struct Partition;
+struct CollectionOptions;
+
+//откуда берутся кандидаты раздела
+enum class PlanKind {
+    FULL_SCAN,//все документы раздела подряд
+    BITMAP,//точное множество по bitmap-индексам: condition или пересечение children
+    LOOKUP,//$eq/$in/$like по индексу поля
+    RANGE,//$gt/$lt по упорядоченному индексу
+    INTERSECT,//номера дает первый потомок, остальные только отсеивают
+    UNION//$or, у каждой ветви свой путь
+};
+
+struct PlanNode {
+    PlanKind kind = PlanKind::FULL_SCAN;
+    const QueryCondition* condition = nullptr;//LOOKUP и BITMAP, указывает в привязанное условие запроса
+    int index = -1;//LOOKUP и RANGE: номер в CollectionOptions::indexes
+    bool hasLower = false;
+    bool hasUpper = false;
+    string lower;//RANGE, границы не включаются
+    string upper;
+    int sortIndex = -1;//INTERSECT: упорядочить результат по значению поля этого индекса
+    Vector<PlanNode> children;
+    size_t estimate = 0;//ожидаемое число кандидатов
+    double cost = 0;//цена получения кандидатов, в проверках документа при полном обходе
+    int orderIndex = -1;//номера в порядке значений этого индекса, -1 - по возрастанию
+    bool exact = false;//BITMAP на все условие запроса: ответ точный, документы не проверяются
+};
+
+//план выборки для одного раздела: оценки берутся из индексов раздела (длины списков,
+//мощности карт, размеры листов), из них выбирается ведущий индекс, фильтры и полный обход
+//план ссылается на привязанное условие, оно должно жить, пока план выполняется
+class QueryPlanner {
+private:
+    const CollectionOptions& options;
+    const Vector<uint32_t>& fieldIds;//номера полей options.indexes в словаре
+    const Partition& partition;
+    size_t rows;//документов в разделе вместе с надгробиями: неточные индексы их тоже помнят
+
+    bool planExact(const QueryCondition& condition, PlanNode& node) const;
+    bool planIndex(const QueryCondition& condition, PlanNode& node) const;
+    bool planAnd(const QueryCondition& condition, PlanNode& node) const;
+    PlanNode intersect(const Vector<const PlanNode*>& sources, size_t driver, int sortIndex) const;
+    double selectivity(size_t estimate) const;
+    bool exactMatches(const QueryCondition& condition, Bitmap& matches) const;
+    void sortByValue(Vector<uint32_t>& positions, int index) const;
+
+public:
+    QueryPlanner(const CollectionOptions& options, const Vector<uint32_t>& fieldIds, const Partition& partition);
+
+    PlanNode plan(const QueryCondition& bound) const;
+    //кандидаты по плану, для FULL_SCAN не вызывается
+    void candidates(const PlanNode& plan, Vector<uint32_t>& positions) const;
+    //номера BITMAP-узла картой; для точного плана это ровно живые совпадения
+    void bitmapMatches(const PlanNode& plan, Bitmap& matches) const;
+    //полная цена: получение кандидатов и их проверка
+    double totalCost(const PlanNode& plan) const;
+    string describe(const PlanNode& plan) const;
+
+    //внутри $and/$or дешевые проверки встают вперед: до дорогой проверки доходят
+    //только документы, которые дешевые не отсеяли
+    static void orderPredicates(QueryCondition& condition);
+    static string describeCondition(const QueryCondition& condition);
+};
+
+#endif
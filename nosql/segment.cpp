@@ -0,0 +1,255 @@
+#include "segment.h"
+#include "binary_io.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+
+static const char SEGMENT_MAGIC[4] = {'N', 'S', 'E', 'G'};
+static const uint32_t SEGMENT_VERSION = 3;
+static const uint32_t SEGMENT_VERSION_SERIALIZED = 2;//документы в формате serialize(), без словаря
+static const uint32_t SEGMENT_VERSION_NO_CRC = 1;//сегменты до контрольных сумм
+static const size_t SEGMENT_HEADER_SIZE = 16;
+static const size_t SEGMENT_FOOTER_SIZE = 12;
+static const size_t RECORD_HEADER_SIZE = 8;
+
+//[len:4][crc:4][data], дополненное нулями до 4 байт
+static void appendRecord(string& buffer, const char* data, size_t len) {
+    appendUint32(buffer, (uint32_t)len);
+    appendUint32(buffer, crc32c(data, len));
+    buffer.append(data, len);
+    buffer.append((4 - len % 4) % 4, '\0');
+}
+
+//словарь читается без блокировки: выданные номера и коды не меняются, а все блоки
+//снимка собраны раньше, поэтому их номера меньше прочитанных размеров
+static string encodeDictionary(const FieldDictionary& fields) {
+    string out;
+    uint32_t fieldCount = fields.size();
+    appendUint32(out, fieldCount);
+    for (uint32_t i = 0; i < fieldCount; i++) {
+        appendString(out, fields.name(i));
+        uint32_t codeCount = fields.codeCount(i);
+        appendUint32(out, codeCount);
+        for (uint32_t c = 0; c < codeCount; c++) {
+            appendString(out, fields.value(i, c));
+        }
+    }
+    return out;
+}
+
+bool SegmentWriter::write(const string& path, const Vector<Document>& documents, const FieldDictionary& fields) {
+    string tmpPath = path + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cerr << "[SEGMENT][ERROR] Failed to create " << tmpPath << ", errno: " << errno << endl;
+        return false;
+    }
+
+    string buffer;
+    buffer.append(SEGMENT_MAGIC, 4);
+    appendUint32(buffer, SEGMENT_VERSION);
+    appendUint64(buffer, documents.size());
+    string dictionary = encodeDictionary(fields);
+    appendRecord(buffer, dictionary.data(), dictionary.size());
+
+    string offsets;
+    uint64_t fileOffset = 0;
+    bool ok = true;
+    for (size_t i = 0; i < documents.size() && ok; i++) {
+        appendUint64(offsets, fileOffset + buffer.size());
+        appendRecord(buffer, documents[i].bytes(), documents[i].byteSize());//блок как есть
+
+        if (buffer.size() >= (1 << 20)) {//пишем кусками по мегабайту
+            ok = writeFully(fd, buffer);
+            fileOffset += buffer.size();
+            buffer.clear();
+        }
+    }
+
+    uint64_t tableOffset = fileOffset + buffer.size();
+    buffer.append(offsets);
+    appendUint64(buffer, tableOffset);
+    buffer.append(SEGMENT_MAGIC, 4);
+    if (ok) {
+        ok = writeFully(fd, buffer);
+    }
+    ok = ok && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (!ok) {
+        cerr << "[SEGMENT][ERROR] Failed to write " << tmpPath << ", errno: " << errno << endl;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    //старый сегмент заменяется только целиком
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0 || !fsyncDirectoryOf(path)) {
+        cerr << "[SEGMENT][ERROR] Failed to replace " << path << ", errno: " << errno << endl;
+        return false;
+    }
+    return true;
+}
+
+SegmentReader::SegmentReader()
+    : fd(-1), base(nullptr), fileSize(0), docCount(0), version(0), offsetTable(nullptr), ownFields(nullptr) {
+}
+
+SegmentReader::~SegmentReader() {
+    close();
+}
+
+bool SegmentReader::open(const string& path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < SEGMENT_HEADER_SIZE + SEGMENT_FOOTER_SIZE) {
+        cerr << "[SEGMENT][ERROR] Segment too small: " << path << endl;
+        close();
+        return false;
+    }
+    fileSize = st.st_size;
+
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        cerr << "[SEGMENT][ERROR] mmap failed for " << path << ", errno: " << errno << endl;
+        base = nullptr;
+        close();
+        return false;
+    }
+    base = (const char*)mapped;
+
+    const char* footer = base + fileSize - SEGMENT_FOOTER_SIZE;
+    uint64_t tableOffset = readUint64(footer);
+    docCount = readUint64(base + 8);
+    version = readUint32(base + 4);
+    //значения из файла ограничиваются до арифметики над ними, чтобы она не переполнилась
+    size_t body = fileSize - SEGMENT_HEADER_SIZE - SEGMENT_FOOTER_SIZE;
+    if (memcmp(base, SEGMENT_MAGIC, 4) != 0 || memcmp(footer + 8, SEGMENT_MAGIC, 4) != 0 ||
+        (version != SEGMENT_VERSION && version != SEGMENT_VERSION_SERIALIZED && version != SEGMENT_VERSION_NO_CRC) ||
+        docCount > body / 8 || tableOffset < SEGMENT_HEADER_SIZE ||
+        tableOffset + docCount * 8 != fileSize - SEGMENT_FOOTER_SIZE) {
+        cerr << "[SEGMENT][ERROR] Corrupted segment: " << path << endl;
+        close();
+        return false;
+    }
+    offsetTable = base + tableOffset;
+
+    if (version != SEGMENT_VERSION) {
+        madvise(mapped, fileSize, MADV_SEQUENTIAL);//старые версии только разбираются подряд
+        return true;
+    }
+    //словарь маленький и нужен сразу, его контрольная сумма проверяется при открытии
+    const char* dictionary = base + SEGMENT_HEADER_SIZE;
+    uint32_t len = tableOffset >= SEGMENT_HEADER_SIZE + RECORD_HEADER_SIZE ? readUint32(dictionary) : 0;
+    if (tableOffset < SEGMENT_HEADER_SIZE + RECORD_HEADER_SIZE ||
+        len > tableOffset - SEGMENT_HEADER_SIZE - RECORD_HEADER_SIZE ||
+        readUint32(dictionary + 4) != crc32c(dictionary + RECORD_HEADER_SIZE, len) ||
+        !readDictionary(dictionary + RECORD_HEADER_SIZE, len)) {
+        cerr << "[SEGMENT][ERROR] Corrupted dictionary in segment: " << path << endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+//номера и коды в свежем словаре выдаются по порядку, поэтому совпадают с файлом,
+//если в файле нет повторов; с повторами блоки ссылались бы не на те имена
+bool SegmentReader::readDictionary(const char* data, size_t len) {
+    ownFields = new FieldDictionary();
+    size_t pos = 0;
+    if (len < 4) return false;
+    uint32_t fieldCount = readUint32(data);
+    pos += 4;
+    for (uint32_t i = 0; i < fieldCount; i++) {
+        string name;
+        if (!readString(data, len, pos, name) || pos + 4 > len) return false;
+        if (i == FieldDictionary::ID_FIELD ? name != "_id" : ownFields->intern(name) != i) return false;
+        uint32_t codeCount = readUint32(data + pos);
+        pos += 4;
+        for (uint32_t c = 0; c < codeCount; c++) {
+            string value;
+            if (!readString(data, len, pos, value)) return false;
+            if (ownFields->encode(i, value.data(), value.size()) != c) return false;
+        }
+    }
+    return pos == len;
+}
+
+void SegmentReader::close() {
+    if (base) {
+        munmap((void*)base, fileSize);
+        base = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    fileSize = 0;
+    docCount = 0;
+    version = 0;
+    offsetTable = nullptr;
+    delete ownFields;
+    ownFields = nullptr;
+}
+
+//запись документа в границах до таблицы смещений
+bool SegmentReader::record(size_t index, const char*& payload, uint32_t& len) const {
+    if (!base || index >= docCount) return false;
+    size_t headerSize = version == SEGMENT_VERSION_NO_CRC ? 4 : RECORD_HEADER_SIZE;
+    size_t limit = offsetTable - base;
+    uint64_t offset = readUint64(offsetTable + index * 8);
+    if (offset < SEGMENT_HEADER_SIZE || offset > limit - headerSize) return false;
+    len = readUint32(base + offset);
+    if (len > limit - offset - headerSize) return false;
+    payload = base + offset + headerSize;
+    return true;
+}
+
+bool SegmentReader::document(size_t index, Document& out, FieldDictionary& fields) const {
+    const char* payload;
+    uint32_t len;
+    if (!record(index, payload, len)) return false;
+    if (version != SEGMENT_VERSION_NO_CRC && readUint32(payload - 4) != crc32c(payload, len)) {
+        cerr << "[SEGMENT][ERROR] Checksum mismatch for document " << index << endl;
+        return false;
+    }
+    if (version != SEGMENT_VERSION) {
+        return Document::deserialize(payload, len, out, fields);
+    }
+    //блок читается со словарем файла и собирается заново с номерами fields
+    Document stored;
+    if (!Document::view(payload, len, *ownFields, stored)) return false;
+    out = Document(stored.getData(), stored.getId(), fields);
+    return true;
+}
+
+bool SegmentReader::bindDictionary(FieldDictionary& fields) const {
+    if (!ownFields) return false;
+    for (uint32_t i = 1; i < ownFields->size(); i++) {
+        const string& name = ownFields->name(i);
+        if (i < fields.size() ? fields.name(i) != name : fields.intern(name) != i) return false;
+        for (uint32_t c = 0; c < ownFields->codeCount(i); c++) {
+            const string& value = ownFields->value(i, c);
+            if (c < fields.codeCount(i) ? fields.value(i, c) != value :
+                fields.encode(i, value.data(), value.size()) != c) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//контрольная сумма блока здесь не считается: открытие не должно читать значения всех документов
+bool SegmentReader::view(size_t index, Document& out, FieldDictionary& fields) const {
+    const char* payload;
+    uint32_t len;
+    return version == SEGMENT_VERSION && record(index, payload, len) &&
+           Document::view(payload, len, fields, out);
+}
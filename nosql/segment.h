@@ -0,0 +1,58 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include "document.h"
+#include "field_dictionary.h"
+#include "vector.h"
+#include <string>
+#include <cstdint>
+using namespace std;
+
+//неизменяемый бинарный файл коллекции
+//[magic:4][version:4][count:8], затем словарь [len:4][crc:4][payload] и документы [len:4][crc:4][блок Document],
+//каждая запись дополнена нулями до 4 байт, чтобы блок можно было читать прямо из отображения
+//словарь: [fieldCount:4] и на каждое поле [имя][codeCount:4] codeCount*[значение], строки с длиной
+//в конце таблица смещений count*[offset:8] и [tableOffset:8][magic:4]
+//версии 1 и 2 без словаря, документы в формате Document::serialize(), читаются только разбором
+class SegmentWriter {
+public:
+    //fields - словарь, из которого собраны блоки documents
+    static bool write(const string& path, const Vector<Document>& documents, const FieldDictionary& fields);
+};
+
+//читает сегмент через mmap: по таблице смещений любой документ разбирается прямо из отображения,
+//а после bindDictionary документ нового формата становится видом на свой блок без копирования
+class SegmentReader {
+private:
+    int fd;
+    const char* base;
+    size_t fileSize;
+    uint64_t docCount;
+    uint32_t version;
+    const char* offsetTable;
+    FieldDictionary* ownFields;//словарь из файла, номера в блоках - его номера
+
+    bool readDictionary(const char* data, size_t len);
+    bool record(size_t index, const char*& payload, uint32_t& len) const;
+
+public:
+    SegmentReader();
+    ~SegmentReader();
+    SegmentReader(const SegmentReader&) = delete;
+    SegmentReader& operator=(const SegmentReader&) = delete;
+
+    bool open(const string& path);
+    void close();
+    size_t count() const { return (size_t)docCount; }
+    size_t mappedBytes() const { return fileSize; }
+    bool contains(const char* p) const { return base && p >= base && p < base + fileSize; }
+    //копия документа в своем блоке, номера полей из fields
+    bool document(size_t index, Document& out, FieldDictionary& fields) const;
+    //дописывает словарь файла в fields; false - блоки нельзя отдавать видами (старая версия
+    //или fields уже разошелся с файлом), тогда документы берутся через document()
+    bool bindDictionary(FieldDictionary& fields) const;
+    //вид на блок в отображении, только после удачного bindDictionary с тем же fields
+    bool view(size_t index, Document& out, FieldDictionary& fields) const;
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <csignal>
 #include <cstdlib>
 #include <memory>
+#include <thread>
 
 using namespace std;
 
@@ -18,13 +19,24 @@ void signalHandler(int signum) {
 
 void printHelp() {
     cout << "=== NoSQL Database Server ===" << endl;
-    cout << "./db_server [port] [workers]" << endl;
+    cout << "./db_server [port] [workers] [опции]" << endl;
     cout << endl;
     cout << "Запуск сервера:" << endl;
     cout << "./db_server" << endl;
     cout << "./db_server 9000" << endl;
     cout << "./db_server 9000 10" << endl;
     cout << endl;
+    cout << "Опции хранения:" << endl;
+    cout << "--compact-wal-mb N       - сжимать журнал коллекции после N МБ (64)" << endl;
+    cout << "--compact-wal-records N  - сжимать журнал после N записей (100000)" << endl;
+    cout << "--compact-interval N     - проверка журналов раз в N секунд (5)" << endl;
+    cout << "--durability MODE        - none | async | fsync, режим по умолчанию (fsync)" << endl;
+    cout << "--db-durability DB=MODE  - режим для отдельной базы данных" << endl;
+    cout << "--flush-interval-ms N    - период фонового сброса для async (1000)" << endl;
+    cout << "--preload                - загрузить все базы до открытия порта" << endl;
+    cout << "--load-threads N         - потоков для --preload (по числу ядер)" << endl;
+    cout << "--memory-limit-mb N      - выгружать давно не нужные коллекции сверх N МБ (0 - без предела)" << endl;
+    cout << endl;
     cout << "Доступные команды:" << endl;
     cout << "status - Статус сервера" << endl;
     cout << "stop - Остановка сервера" << endl;
@@ -35,16 +47,58 @@ int main(int argc, char* argv[]) {
     int port = 8080;
     int workers = 5;
     
-    if (argc > 1) {
-        if (string(argv[1]) == "--help" || string(argv[1]) == "-h") {
+    CompactionPolicy compaction;
+    DurabilityMode durability = DurabilityMode::FSYNC;
+    Vector<pair<string, DurabilityMode>> dbDurability;
+    int flushIntervalMs = 1000;
+    bool preload = false;
+    int loadThreads = (int)thread::hardware_concurrency();
+    size_t memoryLimitMb = 0;
+    int positional = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
             printHelp();
             return 0;
+        } else if (arg == "--compact-wal-mb" && i + 1 < argc) {
+            compaction.maxWalBytes = (size_t)atol(argv[++i]) * 1024 * 1024;
+        } else if (arg == "--compact-wal-records" && i + 1 < argc) {
+            compaction.maxWalRecords = (size_t)atol(argv[++i]);
+        } else if (arg == "--compact-interval" && i + 1 < argc) {
+            compaction.checkIntervalSec = atoi(argv[++i]);
+        } else if (arg == "--durability" && i + 1 < argc) {
+            if (!parseDurabilityMode(argv[++i], durability)) {
+                cerr << "Error: Unknown durability mode: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--db-durability" && i + 1 < argc) {
+            string spec = argv[++i];
+            size_t eq = spec.find('=');
+            DurabilityMode mode;
+            if (eq == string::npos || !parseDurabilityMode(spec.substr(eq + 1), mode)) {
+                cerr << "Error: Expected DB=MODE, got: " << spec << endl;
+                return 1;
+            }
+            dbDurability.push_back(make_pair(spec.substr(0, eq), mode));
+        } else if (arg == "--flush-interval-ms" && i + 1 < argc) {
+            flushIntervalMs = atoi(argv[++i]);
+        } else if (arg == "--preload") {
+            preload = true;
+        } else if (arg == "--load-threads" && i + 1 < argc) {
+            loadThreads = atoi(argv[++i]);
+        } else if (arg == "--memory-limit-mb" && i + 1 < argc) {
+            memoryLimitMb = (size_t)atol(argv[++i]);
+        } else if (positional == 0) {
+            port = atoi(argv[i]);
+            positional++;
+        } else if (positional == 1) {
+            workers = atoi(argv[i]);
+            positional++;
+        } else {
+            cerr << "Error: Unknown argument: " << arg << endl;
+            return 1;
         }
-        port = atoi(argv[1]);
-    }
-    
-    if (argc > 2) {
-        workers = atoi(argv[2]);
     }
     
     if (port < 1 || port > 65535) {
@@ -57,17 +111,42 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    if (flushIntervalMs < 1) {
+        cerr << "Error: Invalid flush interval" << endl;
+        return 1;
+    }
+    
+    if (loadThreads < 1) {
+        loadThreads = 1;
+    }
+    
+    if (compaction.maxWalBytes == 0 || compaction.maxWalRecords == 0 || compaction.checkIntervalSec < 1) {
+        cerr << "Error: Invalid compaction settings" << endl;
+        return 1;
+    }
+    
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
     
     cout << "NoSQL Database Server" << endl;
     cout << "Порт: " << port << endl;
     cout << "Рабочие потоки: " << workers << endl;
+    cout << "Сохранность по умолчанию: " << durabilityModeName(durability) << endl;
     cout << endl;
     cout << "'help' - доступные команды, Ctrl+C - остановить сервер" << endl;
     cout << endl;
 
     server = make_shared<ConnectionManager>();//запуск сервера
+    server->setCompactionPolicy(compaction);
+    server->setDefaultDurability(durability);
+    server->setFlushInterval(flushIntervalMs);
+    server->setMemoryLimit(memoryLimitMb * 1024 * 1024);
+    if (preload) {
+        server->setPreload((size_t)loadThreads);
+    }
+    for (size_t i = 0; i < dbDurability.size(); i++) {
+        server->setDatabaseDurability(dbDurability[i].first, dbDurability[i].second);
+    }
     
     if (!server->start(port, workers)) {
         cerr << "Failed to start server on port " << port << endl;
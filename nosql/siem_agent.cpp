@@ -414,10 +414,7 @@ Vector<SecurityEvent> LogCollector::collectNewEvents() {
         Vector<string> paths = expandPathPattern();
         for (size_t i = 0; i < paths.size(); i++) {
             string current_path = paths[i];
-            Vector<SecurityEvent> path_events = readFromSpecificPath(current_path);
-            for (size_t j = 0; j < path_events.size(); j++) {
-                events.push_back(path_events[j]);
-            }
+            events.append(readFromSpecificPath(current_path));
         }
         return events;
     }
@@ -483,7 +480,7 @@ Vector<SecurityEvent> LogCollector::collectNewEvents() {
             event.timestamp = file_timestamp;
         }
 
-        events.push_back(event);
+        events.push_back(std::move(event));
         lines_read++;
     }
 
@@ -605,7 +602,7 @@ Vector<SecurityEvent> LogCollector::readFromSpecificPath(const string& specific_
             event.timestamp = file_timestamp;
         }
 
-        events.push_back(event);
+        events.push_back(std::move(event));
         lines_read++;
     }
 
@@ -869,8 +866,7 @@ void SIEMAgent::sendEventsToDB(const Vector<SecurityEvent>& events) {
         req.collection = config.collection;
 
         for (size_t i = start; i < end; i++) {
-            SecurityEvent event = events[i];
-            string event_json = event.toJson();
+            string event_json = events[i].toJson();
             if (event_json.empty() || event_json[0] != '{') {
                 cout << "ERROR: Invalid JSON from event: " << event_json.substr(0, 50) << endl;
                 continue;
@@ -906,9 +902,7 @@ void SIEMAgent::sendEventsToDB(const Vector<SecurityEvent>& events) {
             logMessage("Send error in batch " + to_string(batch_count) + ": " + response.message, "ERROR");
 
             Vector<SecurityEvent> failed_batch;
-            for (size_t i = start; i < end; i++) {
-                failed_batch.push_back(events[i]);
-            }
+            failed_batch.insert(0, &events[start], &events[0] + end);
             buffer->addEvents(failed_batch);
 
             this_thread::sleep_for(chrono::seconds(1));
@@ -0,0 +1,87 @@
+#include "thread_pool.h"
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount) : stopping(false) {
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.push_back(thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCV.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        if (workers[i].joinable()) {
+            workers[i].join();
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueCV.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;//stopping и очередь разобрана
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::submit(function<void()> task) {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        tasks.push(std::move(task));
+    }
+    queueCV.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& body) {
+    if (count == 0) return;
+
+    struct State {
+        atomic<size_t> next{0};
+        size_t finished = 0;
+        mutex doneMutex;
+        condition_variable doneCV;
+    };
+    shared_ptr<State> state = make_shared<State>();
+    size_t total = count;
+
+    //разбирает индексы, пока они есть; помощник, пришедший поздно, сразу выходит
+    auto run = [state, total, &body]() {
+        size_t done = 0;
+        size_t i;
+        while ((i = state->next.fetch_add(1)) < total) {
+            body(i);
+            done++;
+        }
+        if (done > 0) {
+            lock_guard<mutex> lock(state->doneMutex);
+            state->finished += done;
+            if (state->finished == total) {
+                state->doneCV.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(workers.size(), count - 1);
+    for (size_t h = 0; h < helpers; h++) {
+        submit(run);
+    }
+    run();
+
+    //body живет до выхода отсюда: ждем все индексы, а не помощников
+    unique_lock<mutex> lock(state->doneMutex);
+    state->doneCV.wait(lock, [&]() { return state->finished == total; });
+}
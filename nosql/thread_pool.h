@@ -0,0 +1,36 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "vector.h"
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <thread>
+using namespace std;
+
+//пул потоков для загрузки данных при старте
+class ThreadPool {
+private:
+    Vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex queueMutex;
+    condition_variable queueCV;
+    bool stopping;
+
+    void workerLoop();
+
+public:
+    explicit ThreadPool(size_t threadCount);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+    void submit(function<void()> task);
+    //body(i) для i в [0, count), вызывающий поток работает наравне с пулом,
+    //поэтому вложенные вызовы не блокируют друг друга
+    void parallelFor(size_t count, const function<void(size_t)>& body);
+};
+
+#endif
@@ -1,33 +1,74 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include "allocator.h"
 #include <string>
 using namespace std;
 
+//место под InlineCount элементов прямо в объекте, для 0 - пустая база без размера
+template<typename T, size_t InlineCount>
+struct VectorInlineStorage {
+    alignas(T) unsigned char bytes[InlineCount * sizeof(T)];
+    T* inlineData() const { return (T*)bytes; }
+};
+
 template<typename T>
-class Vector {
+struct VectorInlineStorage<T, 0> {
+    T* inlineData() const { return nullptr; }
+};
+
+//элементы живут в сырой памяти от allocator, конструируются по мере добавления
+//InlineCount > 0: первые элементы хранятся в самом объекте, куча нужна только при переполнении
+template<typename T, size_t InlineCount = 0>
+class Vector : private VectorInlineStorage<T, InlineCount> {
 private:
     T* data;
     size_t capacity;
     size_t sizeVal;
+    Allocator* allocator;//nullptr - куча
+
+    template<typename, size_t> friend class Vector;
+
+    bool isInline() const { return InlineCount > 0 && data == this->inlineData(); }
+    void destroyAll();
+    void grow(size_t newCapacity);
+    void growFor(size_t extra);
+    void freeStorage();
+    template<size_t M>
+    void takeFrom(Vector<T, M>&& other);
 
 public:
     Vector();
+    explicit Vector(Allocator* source);
     ~Vector();
-    Vector(const Vector& other);//копир
-    Vector& operator=(const Vector& other);//присванвание
-    Vector(Vector&& other) noexcept;//перемещение
+    Vector(const Vector& other);//копир, память из кучи
+    Vector& operator=(const Vector& other);//присванвание, источник памяти свой
+    Vector(Vector&& other) noexcept;//перемещение вместе с источником
     Vector& operator=(Vector&& other) noexcept;//операторп рисваивания перемещением
+    template<size_t M>
+    Vector(Vector<T, M>&& other) noexcept;//из вектора с другим встроенным размером
+    template<size_t M>
+    Vector& operator=(Vector<T, M>&& other) noexcept;
+
+    void reserve(size_t count);//без перевыделений до count элементов
     void push_back(const T& value);
-    void push_back(T&& value); 
-    void pop_back();  
-    T& back(); 
-    const T& back() const;  
+    void push_back(T&& value);
+    template<typename... Args>
+    T& emplace_back(Args&&... args);//конструирует прямо в буфере
+    void insert(size_t position, const T* first, const T* last);//копии [first, last) перед position
+    template<size_t M>
+    void append(Vector<T, M>&& other);//переносит все элементы other в конец
+    void erase(size_t first, size_t last);//удаляет [first, last), хвост сдвигается перемещением
+    void pop_back();
+    T& back();
+    const T& back() const;
     T& operator[](size_t index);
     const T& operator[](size_t index) const;
     size_t size() const;
     bool empty() const;
     void clear();
+    Allocator* getAllocator() const { return allocator; }
+    size_t memoryBytes() const { return isInline() ? 0 : capacity * sizeof(T); }//буфер вне объекта
 
     class Iterator {
     private:
@@ -38,11 +79,11 @@ public:
         Iterator& operator++();
         bool operator!=(const Iterator& other);
     };
-    
+
     Iterator begin();
     Iterator end();
 };
 
 #include "VectorImpl.h"
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,349 @@
+#include "wal.h"
+#include "binary_io.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <iostream>
+#include <sys/stat.h>
+
+static const char WAL_MAGIC[4] = {'N', 'W', 'A', 'L'};
+static const uint32_t WAL_VERSION = 2;
+static const size_t WAL_HEADER_SIZE = 8;
+static const size_t WAL_RECORD_HEADER_SIZE = 9;
+
+static string walHeader() {
+    string header(WAL_MAGIC, 4);
+    appendUint32(header, WAL_VERSION);
+    return header;
+}
+
+static uint32_t recordChecksum(char op, const char* payload, size_t len) {
+    return crc32c(payload, len, crc32c(&op, 1));
+}
+
+bool parseDurabilityMode(const string& str, DurabilityMode& mode) {
+    if (str == "none") {
+        mode = DurabilityMode::NONE;
+    } else if (str == "async") {
+        mode = DurabilityMode::ASYNC;
+    } else if (str == "fsync") {
+        mode = DurabilityMode::FSYNC;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+string durabilityModeName(DurabilityMode mode) {
+    switch (mode) {
+        case DurabilityMode::NONE: return "none";
+        case DurabilityMode::ASYNC: return "async";
+        case DurabilityMode::FSYNC: return "fsync";
+    }
+    return "unknown";
+}
+
+WriteAheadLog::WriteAheadLog(const string& walPath)
+    : path(walPath), fd(-1), bytesWritten(0), recordCount(0),
+      lastSequence(0), durableSequence(0), pendingRecords(0), durableOffset(0), broken(false), damaged(false), flushing(false) {
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    unique_lock<mutex> lock(commitMutex);
+    flushPendingLocked(lock);
+    closeLocked();
+}
+
+bool WriteAheadLog::openLocked() {
+    if (fd >= 0) return true;
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        cerr << "[WAL][ERROR] Failed to open " << path << ", errno: " << errno << endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0) {
+        //новый файл: заголовок и запись в каталоге должны быть на диске раньше первых записей
+        if (!writeFully(fd, walHeader()) || ::fsync(fd) != 0 || !fsyncDirectoryOf(path)) {
+            cerr << "[WAL][ERROR] Failed to initialize " << path << ", errno: " << errno << endl;
+            closeLocked();
+            return false;
+        }
+    }
+    durableOffset = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+    return true;
+}
+
+void WriteAheadLog::closeLocked() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void WriteAheadLog::encodeRecord(string& out, WalOp op, const string& payload) {
+    out.push_back((char)op);
+    appendUint32(out, (uint32_t)payload.size());
+    appendUint32(out, recordChecksum((char)op, payload.data(), payload.size()));
+    out.append(payload);
+}
+
+uint64_t WriteAheadLog::enqueue(const string& records, size_t count) {
+    lock_guard<mutex> lock(commitMutex);
+    pending.append(records);
+    pendingRecords += count;
+    bytesWritten += records.size();
+    recordCount += count;
+    return ++lastSequence;
+}
+
+//пачка в конец файла; при ошибке файл обрезается до offset, torn - обрезать не удалось
+bool WriteAheadLog::writeBatch(int writeFd, size_t offset, const string& batch, bool syncToDisk, bool& torn) {
+    torn = false;
+    bool ok = writeFully(writeFd, batch);
+    if (ok && syncToDisk) {
+        ok = ::fsync(writeFd) == 0;
+    }
+    if (!ok) {
+        //недописанная пачка не должна остаться перед следующими: recover остановится на ней
+        torn = ::ftruncate(writeFd, (off_t)offset) != 0;
+    }
+    return ok;
+}
+
+void WriteAheadLog::finishBatchLocked(uint64_t from, uint64_t to, size_t bytes, size_t records, bool ok, bool torn) {
+    if (ok) {
+        durableOffset += bytes;
+    } else {
+        cerr << "[WAL][ERROR] Failed to write " << bytes << " bytes to " << path << ", errno: " << errno
+             << (torn ? ", log is closed for writes until rotation" : "") << endl;
+        bytesWritten -= bytes;
+        recordCount -= records;
+        broken = broken || torn;
+        if (!failedRanges.empty() && failedRanges.back().second + 1 == from) {
+            failedRanges.back().second = to;
+        } else if (from <= to) {
+            failedRanges.push_back(make_pair(from, to));
+        }
+    }
+    durableSequence = to;
+    flushing = false;
+    commitCV.notify_all();
+}
+
+bool WriteAheadLog::failedLocked(uint64_t sequence) const {
+    size_t first = 0, last = failedRanges.size();
+    while (first < last) {
+        size_t middle = (first + last) / 2;
+        if (failedRanges[middle].second < sequence) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first < failedRanges.size() && failedRanges[first].first <= sequence;
+}
+
+bool WriteAheadLog::commit(uint64_t sequence, bool syncToDisk) {
+    unique_lock<mutex> lock(commitMutex);
+    while (durableSequence < sequence) {
+        if (flushing) {
+            //пачку запишет текущий лидер или следующий за ним
+            commitCV.wait(lock);
+            continue;
+        }
+
+        //становимся лидером: забираем все накопленное от всех соединений
+        flushing = true;
+        string batch;
+        batch.swap(pending);
+        size_t batchRecords = pendingRecords;
+        pendingRecords = 0;
+        uint64_t batchFrom = durableSequence + 1;
+        uint64_t batchTo = lastSequence;
+        bool opened = !broken && openLocked();
+        int writeFd = fd;
+        size_t offset = durableOffset;
+        lock.unlock();
+
+        bool torn = false;
+        bool ok = opened && writeBatch(writeFd, offset, batch, syncToDisk, torn);
+
+        lock.lock();
+        finishBatchLocked(batchFrom, batchTo, batch.size(), batchRecords, ok, torn);
+    }
+    return !failedLocked(sequence);
+}
+
+bool WriteAheadLog::flush(bool syncToDisk) {
+    uint64_t sequence;
+    {
+        lock_guard<mutex> lock(commitMutex);
+        sequence = lastSequence;
+    }
+    return commit(sequence, syncToDisk);
+}
+
+bool WriteAheadLog::flushPendingLocked(unique_lock<mutex>& lock) {
+    commitCV.wait(lock, [this]() { return !flushing; });
+    if (pending.empty()) {
+        return true;
+    }
+    string batch;
+    batch.swap(pending);
+    size_t batchRecords = pendingRecords;
+    pendingRecords = 0;
+    bool torn = false;
+    bool ok = !broken && openLocked() && writeBatch(fd, durableOffset, batch, true, torn);
+    finishBatchLocked(durableSequence + 1, lastSequence, batch.size(), batchRecords, ok, torn);
+    return ok;
+}
+
+//файл целиком в память, false при ошибке чтения
+static bool readWholeFile(const string& file, string& content, bool& exists) {
+    exists = false;
+    int readFd = ::open(file.c_str(), O_RDONLY);
+    if (readFd < 0) {
+        return errno == ENOENT;
+    }
+    exists = true;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = ::read(readFd, buffer, sizeof(buffer))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ::close(readFd);
+            return false;
+        }
+        content.append(buffer, n);
+    }
+    ::close(readFd);
+    return true;
+}
+
+bool WriteAheadLog::recover(const string& file, const function<void(WalOp, const string&)>& apply,
+                            size_t& validBytes, size_t& count) {
+    validBytes = 0;
+    count = 0;
+    string content;
+    bool exists;
+    if (!readWholeFile(file, content, exists)) {
+        return false;
+    }
+    if (!exists) {
+        return true;//журнала еще нет
+    }
+
+    //оборванный при создании заголовок - это пустой журнал, любой другой заголовок - не наш файл
+    bool magicOk = content.size() >= WAL_HEADER_SIZE ?
+                   memcmp(content.data(), WAL_MAGIC, 4) == 0 :
+                   content.compare(0, content.size(), WAL_MAGIC, content.size()) == 0;
+    if (!magicOk) {
+        cerr << "[WAL][ERROR] Bad log header in " << file << endl;
+        return false;
+    }
+    if (content.size() >= WAL_HEADER_SIZE && readUint32(content.data() + 4) != WAL_VERSION) {
+        cerr << "[WAL][ERROR] Unsupported log version in " << file << endl;
+        return false;
+    }
+
+    size_t pos = std::min(content.size(), WAL_HEADER_SIZE);
+    while (pos + WAL_RECORD_HEADER_SIZE <= content.size()) {
+        char op = content[pos];
+        uint32_t len = readUint32(content.data() + pos + 1);
+        if (pos + WAL_RECORD_HEADER_SIZE + len > content.size()) {
+            break;//недописанная запись в конце
+        }
+        const char* payload = content.data() + pos + WAL_RECORD_HEADER_SIZE;
+        if (readUint32(content.data() + pos + 5) != recordChecksum(op, payload, len)) {
+            break;//оборванная запись: дальше ничего надежного нет
+        }
+        apply((WalOp)op, string(payload, len));
+        pos += WAL_RECORD_HEADER_SIZE + len;
+        count++;
+    }
+
+    if (pos < content.size() || content.size() < WAL_HEADER_SIZE) {
+        //все до оборванной записи сохраняется, хвост обрезается,
+        //иначе новые записи окажутся за мусором и пропадут при следующем чтении
+        if (content.size() >= WAL_HEADER_SIZE) {
+            cerr << "[WAL][WARN] Truncating " << (content.size() - pos)
+                 << " trailing bytes in " << file << " after " << count << " record(s)" << endl;
+        }
+        if (::truncate(file.c_str(), content.size() < WAL_HEADER_SIZE ? 0 : pos) != 0) {
+            cerr << "[WAL][ERROR] Failed to truncate " << file << ", errno: " << errno << endl;
+            return false;
+        }
+    }
+    validBytes = pos > WAL_HEADER_SIZE ? pos - WAL_HEADER_SIZE : 0;
+    return true;
+}
+
+bool WriteAheadLog::replay(const function<void(WalOp, const string&)>& apply) {
+    lock_guard<mutex> lock(commitMutex);
+    if (!recover(path, apply, bytesWritten, recordCount)) {
+        damaged = true;
+        broken = true;
+        return false;
+    }
+    return true;
+}
+
+bool WriteAheadLog::rotate(const string& frozenPath) {
+    unique_lock<mutex> lock(commitMutex);
+    if (damaged) {
+        cerr << "[WAL][ERROR] Not rotating unreadable log " << path << endl;
+        return false;
+    }
+    //все поставленное до сжатия должно попасть в старый файл; пачки, которые не записались,
+    //отклонены и убраны из памяти их владельцами, снимок их не содержит
+    flushPendingLocked(lock);
+    closeLocked();
+    if (::rename(path.c_str(), frozenPath.c_str()) != 0 && errno != ENOENT) {
+        cerr << "[WAL][ERROR] Failed to rotate " << path << ", errno: " << errno << endl;
+        return false;
+    }
+    bytesWritten = 0;
+    recordCount = 0;
+    broken = false;//новый файл начинается чисто, битый хвост остался в замороженном
+    return true;
+}
+
+bool WriteAheadLog::unrotate(const string& frozenPath) {
+    unique_lock<mutex> lock(commitMutex);
+    flushPendingLocked(lock);//неудачная пачка уже отклонена, битый хвост обрежет recover ниже
+    closeLocked();
+    //дописываем записи текущего журнала в конец замороженного и возвращаем его на место
+    string tail;
+    bool exists;
+    if (!readWholeFile(path, tail, exists)) {
+        return false;
+    }
+    if (tail.size() >= WAL_HEADER_SIZE && memcmp(tail.data(), WAL_MAGIC, 4) == 0) {
+        tail.erase(0, WAL_HEADER_SIZE);
+    }
+    //в замороженном мог остаться необрезанный хвост неудачной записи, новые записи - только после него
+    size_t frozenBytes, frozenRecords;
+    if (!recover(frozenPath, [](WalOp, const string&) {}, frozenBytes, frozenRecords)) {
+        return false;
+    }
+
+    int frozenFd = ::open(frozenPath.c_str(), O_WRONLY | O_APPEND);
+    if (frozenFd < 0) {
+        return errno == ENOENT;
+    }
+    bool ok = writeFully(frozenFd, tail) && ::fsync(frozenFd) == 0;
+    ::close(frozenFd);
+    if (!ok) {
+        return false;
+    }
+
+    if (::rename(frozenPath.c_str(), path.c_str()) != 0) {
+        cerr << "[WAL][ERROR] Failed to restore " << frozenPath << ", errno: " << errno << endl;
+        return false;
+    }
+    broken = false;
+    return recover(path, [](WalOp, const string&) {}, bytesWritten, recordCount);
+}
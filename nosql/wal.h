@@ -0,0 +1,93 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <string>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <utility>
+#include "vector.h"
+using namespace std;
+
+enum class WalOp : char {
+    INSERT = 'I',
+    DELETE = 'D',
+    DROP_PARTITION = 'P'//раздел удален целиком по сроку хранения
+};
+
+//когда изменения считаются сохраненными
+enum class DurabilityMode {
+    //вставки не пишутся в журнал и попадают на диск со следующим снимком (сжатие, выгрузка),
+    //до него падение их теряет; удаления все равно журналируются как в async
+    NONE,
+    ASYNC,//журнал сбрасывается фоновым потоком раз в интервал
+    FSYNC//fsync журнала до ответа клиенту
+};
+
+bool parseDurabilityMode(const string& str, DurabilityMode& mode);
+string durabilityModeName(DurabilityMode mode);
+
+//журнал коллекции: только дописывание в конец, одна запись на операцию
+//файл начинается с [magic "NWAL":4][version:4]
+//формат записи: [op:1][len:4][crc:4][payload:len], crc - CRC-32C от op и payload
+//записи копятся в буфере, commit пишет все накопленное одним write (групповая фиксация)
+class WriteAheadLog {
+private:
+    string path;
+    int fd;
+    size_t bytesWritten;
+    size_t recordCount;
+
+    mutex commitMutex;
+    condition_variable commitCV;
+    string pending;//закодированные записи, еще не отданные в файл
+    uint64_t lastSequence;//номер последней поставленной пачки
+    uint64_t durableSequence;//все пачки до этого номера уже в файле
+    size_t pendingRecords;//записей в pending
+    size_t durableOffset;//размер файла после последней удачной записи
+    //пачки, запись которых не удалась, по возрастанию; соседние сливаются, сбои редки,
+    //поэтому список не чистится: ожидающий может проснуться сколь угодно поздно
+    Vector<pair<uint64_t, uint64_t>> failedRanges;
+    //хвост неудачной записи не удалось обрезать: до ротации в файл больше не пишем,
+    //иначе новые записи легли бы за мусором и пропали при восстановлении
+    bool broken;
+    //журнал не прочитался при загрузке: файл остается как есть до ручного разбора,
+    //в него не пишем и не ротируем, иначе сжатие удалило бы его вместе с замороженным
+    bool damaged;
+    bool flushing;//кто-то из потоков сейчас пишет за всех
+
+    bool openLocked();
+    void closeLocked();
+    bool flushPendingLocked(unique_lock<mutex>& lock);
+    void finishBatchLocked(uint64_t from, uint64_t to, size_t bytes, size_t records, bool ok, bool torn);
+    bool failedLocked(uint64_t sequence) const;
+    static bool writeBatch(int writeFd, size_t offset, const string& batch, bool syncToDisk, bool& torn);
+
+public:
+    WriteAheadLog(const string& walPath);
+    ~WriteAheadLog();
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    static void encodeRecord(string& out, WalOp op, const string& payload);
+
+    uint64_t enqueue(const string& records, size_t count);//возвращает номер пачки
+    //ждет, пока пачка окажется в файле; false - пачка не записана и в журнале ее нет
+    bool commit(uint64_t sequence, bool syncToDisk);
+    bool flush(bool syncToDisk);//сбросить все поставленное на данный момент
+    bool replay(const function<void(WalOp, const string&)>& apply);
+    bool rotate(const string& frozenPath);//журнал уходит на сжатие, пишем в новый
+    bool unrotate(const string& frozenPath);//возврат замороженного журнала обратно
+
+    //читает записи до первой недописанной или битой, хвост после нее обрезается
+    //журнал старого формата без заголовка переписывается в текущий
+    static bool recover(const string& file, const function<void(WalOp, const string&)>& apply,
+                        size_t& validBytes, size_t& count);
+
+    const string& getPath() const { return path; }
+    size_t sizeBytes() const { return bytesWritten; }
+    size_t records() const { return recordCount; }
+};
+
+#endif